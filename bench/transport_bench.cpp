@@ -0,0 +1,184 @@
+// 传输层基准测试
+// 比较 TCP 回环、Unix 域套接字（抽象命名空间）与进程内回环的往返延迟和吞吐量。
+// 两端都使用客户端实际的 FrameReader/FrameWriter，服务端在同一进程的线程中回显。
+#include "frame_reader.h"
+#include "frame_writer.h"
+#include "transport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// 回显服务：以 'p' 开头的帧原样返回，以 'b' 开头的帧只计数，'s' 返回累计字节数
+void serve(std::unique_ptr<Transport> transport) {
+    FrameReader reader(transport.get());
+    FrameWriter writer(transport.get());
+    const char* body = nullptr;
+    size_t length = 0;
+    size_t bulkBytes = 0;
+
+    while (reader.readFrame(body, length) == FrameReader::Status::Frame) {
+        if (length == 0) {
+            continue;
+        }
+        if (body[0] == 'p') {
+            writer.writeFrame(std::string(body, length));
+        } else if (body[0] == 'b') {
+            bulkBytes += length;
+        } else if (body[0] == 's') {
+            writer.writeFrame("s" + std::to_string(bulkBytes));
+            bulkBytes = 0;
+        }
+    }
+}
+
+// 接受一个连接后在线程中回显，返回监听 fd 已关闭
+std::thread serveOnce(int listenFd) {
+    return std::thread([listenFd]() {
+        int conn = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        close(listenFd);
+        if (conn >= 0) {
+            serve(std::unique_ptr<Transport>(new FdTransport(conn, conn)));
+        }
+    });
+}
+
+struct Result {
+    double p50Us;
+    double p99Us;
+    double avgUs;
+    double throughputMBs;
+};
+
+Result run(Transport& transport, int iterations, size_t bulkSize, int bulkFrames) {
+    FrameReader reader(&transport);
+    FrameWriter writer(&transport);
+    const char* body = nullptr;
+    size_t length = 0;
+
+    // 往返延迟：小帧 ping-pong
+    std::string ping = "p{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"$/ping\",\"params\":{}}";
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        writer.writeFrame(ping);
+        if (reader.readFrame(body, length) != FrameReader::Status::Frame) {
+            std::cerr << "读取回显失败" << std::endl;
+            std::exit(1);
+        }
+        samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+
+    // 吞吐量：批量发送大帧，最后用同步帧确认服务端全部收到
+    std::string bulk(bulkSize, 'x');
+    bulk[0] = 'b';
+    auto start = Clock::now();
+    for (int i = 0; i < bulkFrames; ++i) {
+        writer.writeFrame(bulk);
+    }
+    writer.writeFrame("s");
+    if (reader.readFrame(body, length) != FrameReader::Status::Frame) {
+        std::cerr << "读取同步帧失败" << std::endl;
+        std::exit(1);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Result result;
+    result.p50Us = samples[samples.size() / 2];
+    result.p99Us = samples[samples.size() * 99 / 100];
+    result.avgUs = total / samples.size();
+    result.throughputMBs = static_cast<double>(bulkSize) * bulkFrames / (1024.0 * 1024.0) / seconds;
+    return result;
+}
+
+void report(const char* name, const Result& result) {
+    std::cout << name
+              << "  p50 " << result.p50Us << " us"
+              << "  p99 " << result.p99Us << " us"
+              << "  avg " << result.avgUs << " us"
+              << "  吞吐 " << result.throughputMBs << " MB/s" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20000;
+    size_t bulkSize = 256 * 1024;
+    int bulkFrames = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    std::cout << "往返次数: " << iterations << "，批量帧: " << bulkFrames
+              << " x " << bulkSize / 1024 << " KB" << std::endl;
+
+    // TCP 回环，由内核分配端口
+    {
+        int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrLength = sizeof(addr);
+        if (bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), addrLength) < 0 || listen(listenFd, 1) < 0 ||
+            getsockname(listenFd, reinterpret_cast<struct sockaddr*>(&addr), &addrLength) < 0) {
+            std::cerr << "创建TCP监听失败" << std::endl;
+            return 1;
+        }
+        std::thread server = serveOnce(listenFd);
+        auto transport = TcpTransport::connect("127.0.0.1", ntohs(addr.sin_port));
+        if (!transport) {
+            return 1;
+        }
+        report("TCP     ", run(*transport, iterations, bulkSize, bulkFrames));
+        transport->close();
+        server.join();
+    }
+
+    // Unix 域套接字，抽象命名空间
+    {
+        std::string path = "@lsp-client-bench-" + std::to_string(getpid());
+        int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_un addr;
+        socklen_t addrLength = UnixSocketTransport::makeAddress(path, addr);
+        if (bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), addrLength) < 0 || listen(listenFd, 1) < 0) {
+            std::cerr << "创建Unix套接字监听失败" << std::endl;
+            return 1;
+        }
+        std::thread server = serveOnce(listenFd);
+        auto transport = UnixSocketTransport::connect(path);
+        if (!transport) {
+            return 1;
+        }
+        report("Unix    ", run(*transport, iterations, bulkSize, bulkFrames));
+        transport->close();
+        server.join();
+    }
+
+    // 进程内回环
+    {
+        auto pair = LoopbackTransport::createPair();
+        std::thread server(serve, std::move(pair.second));
+        report("Loopback", run(*pair.first, iterations, bulkSize, bulkFrames));
+        pair.first->close();
+        server.join();
+    }
+
+    return 0;
+}
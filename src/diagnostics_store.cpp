@@ -0,0 +1,56 @@
+#include "diagnostics_store.h"
+#include <functional>
+
+DiagnosticsStore::DiagnosticsStore() : empty(std::make_shared<const std::vector<json>>()) {
+    for (Shard& shard : shards) {
+        shard.index.store(std::make_shared<const Index>());
+    }
+}
+
+DiagnosticsStore::Shard& DiagnosticsStore::shardFor(const std::string& uri) const {
+    return shards[std::hash<std::string>()(uri) % kShardCount];
+}
+
+DiagnosticsSnapshot DiagnosticsStore::get(const std::string& uri) const {
+    std::shared_ptr<const Index> index = shardFor(uri).index.load(std::memory_order_acquire);
+    auto it = index->find(uri);
+    if (it == index->end()) {
+        return empty;
+    }
+    DiagnosticsSnapshot snapshot = it->second->snapshot.load(std::memory_order_acquire);
+    return snapshot ? snapshot : empty;
+}
+
+std::shared_ptr<DiagnosticsStore::Slot> DiagnosticsStore::slotFor(const std::string& uri) {
+    Shard& shard = shardFor(uri);
+    std::shared_ptr<const Index> index = shard.index.load(std::memory_order_acquire);
+    auto it = index->find(uri);
+    if (it != index->end()) {
+        return it->second;
+    }
+
+    // 新 URI：复制索引、插入槽位后整体发布
+    std::lock_guard<std::mutex> lock(shard.writeMutex);
+    index = shard.index.load(std::memory_order_acquire);
+    it = index->find(uri);
+    if (it != index->end()) {
+        return it->second;
+    }
+    auto updated = std::make_shared<Index>(*index);
+    auto slot = std::make_shared<Slot>();
+    updated->emplace(uri, slot);
+    shard.index.store(std::move(updated), std::memory_order_release);
+    return slot;
+}
+
+void DiagnosticsStore::publish(const std::string& uri, std::vector<json> diagnostics) {
+    auto snapshot = std::make_shared<const std::vector<json>>(std::move(diagnostics));
+    slotFor(uri)->snapshot.store(std::move(snapshot), std::memory_order_release);
+}
+
+void DiagnosticsStore::clear() {
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.writeMutex);
+        shard.index.store(std::make_shared<const Index>(), std::memory_order_release);
+    }
+}
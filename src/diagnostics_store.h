@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// 某个文档诊断信息的不可变快照，永远不为空指针
+using DiagnosticsSnapshot = std::shared_ptr<const std::vector<json>>;
+
+// 并发诊断信息存储
+// 每个 URI 对应一个槽位，槽位中保存当前快照的原子指针：
+// 读者原子地取出快照即可，不加锁也不拷贝；写者构造新快照后原子替换，
+// 旧快照在最后一个读者释放后回收。URI 到槽位的索引按分片做写时复制，
+// 只有第一次出现的 URI 才需要复制索引
+class DiagnosticsStore {
+public:
+    DiagnosticsStore();
+
+    // 取得 uri 当前的诊断快照，没有时返回共享的空快照
+    DiagnosticsSnapshot get(const std::string& uri) const;
+
+    // 发布 uri 的新诊断信息
+    void publish(const std::string& uri, std::vector<json> diagnostics);
+
+    // 清空所有诊断信息
+    void clear();
+
+private:
+    struct Slot {
+        std::atomic<DiagnosticsSnapshot> snapshot;
+    };
+
+    using Index = std::unordered_map<std::string, std::shared_ptr<Slot>>;
+
+    struct alignas(64) Shard {
+        std::atomic<std::shared_ptr<const Index>> index;
+        std::mutex writeMutex;  // 只在新增 URI 时使用
+    };
+
+    static constexpr size_t kShardCount = 16;
+
+    Shard& shardFor(const std::string& uri) const;
+
+    // 查找或创建 uri 的槽位
+    std::shared_ptr<Slot> slotFor(const std::string& uri);
+
+    mutable std::array<Shard, kShardCount> shards;
+    DiagnosticsSnapshot empty;
+};
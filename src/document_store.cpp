@@ -0,0 +1,411 @@
+#include "document_store.h"
+#include <algorithm>
+#include <random>
+
+// treap 节点：一个片段加上子树统计
+struct Document::Node {
+    NodePtr left;
+    NodePtr right;
+    std::shared_ptr<const std::string> buffer;
+    size_t offset;        // 片段在缓冲区中的起点
+    size_t length;        // 片段字节数
+    std::shared_ptr<const std::vector<uint32_t>> newlines;  // 片段内换行符的偏移，复制节点时共享
+    size_t size;          // 子树字节数
+    size_t lines;         // 子树换行数
+    uint32_t priority;
+
+    const char* data() const { return buffer->data() + offset; }
+    size_t pieceLines() const { return newlines->size(); }
+};
+
+namespace {
+
+using Node = Document::Node;
+using NodePtr = Document::NodePtr;
+
+// 片段上限，保证切分片段时统计换行的代价是常数
+constexpr size_t kMaxPiece = 4096;
+
+uint32_t nextPriority() {
+    thread_local std::minstd_rand random(std::random_device{}());
+    return static_cast<uint32_t>(random());
+}
+
+size_t sizeOf(const NodePtr& node) { return node ? node->size : 0; }
+size_t linesOf(const NodePtr& node) { return node ? node->lines : 0; }
+
+NodePtr makeNode(NodePtr left, NodePtr right, const std::shared_ptr<const std::string>& buffer,
+                 size_t offset, size_t length, std::shared_ptr<const std::vector<uint32_t>> newlines,
+                 uint32_t priority) {
+    auto node = std::make_shared<Node>();
+    node->size = sizeOf(left) + length + sizeOf(right);
+    node->lines = linesOf(left) + newlines->size() + linesOf(right);
+    node->left = std::move(left);
+    node->right = std::move(right);
+    node->buffer = buffer;
+    node->offset = offset;
+    node->length = length;
+    node->newlines = std::move(newlines);
+    node->priority = priority;
+    return node;
+}
+
+// 保留 node 的片段和优先级，替换左右子树
+NodePtr withChildren(const NodePtr& node, NodePtr left, NodePtr right) {
+    return makeNode(std::move(left), std::move(right), node->buffer, node->offset, node->length,
+                    node->newlines, node->priority);
+}
+
+NodePtr makeLeaf(const std::shared_ptr<const std::string>& buffer, size_t offset, size_t length) {
+    auto newlines = std::make_shared<std::vector<uint32_t>>();
+    PositionCodec::findNewlines(buffer->data() + offset, length, *newlines);
+    return makeNode(nullptr, nullptr, buffer, offset, length, std::move(newlines), nextPriority());
+}
+
+NodePtr merge(const NodePtr& a, const NodePtr& b) {
+    if (!a) {
+        return b;
+    }
+    if (!b) {
+        return a;
+    }
+    if (a->priority > b->priority) {
+        return withChildren(a, a->left, merge(a->right, b));
+    }
+    return withChildren(b, merge(a, b->left), b->right);
+}
+
+// 按字节位置切成前 pos 字节和其余部分，只复制路径上的节点
+std::pair<NodePtr, NodePtr> split(const NodePtr& node, size_t pos) {
+    if (!node) {
+        return {nullptr, nullptr};
+    }
+    size_t leftSize = sizeOf(node->left);
+    if (pos <= leftSize) {
+        auto [left, right] = split(node->left, pos);
+        return {left, withChildren(node, right, node->right)};
+    }
+    if (pos >= leftSize + node->length) {
+        auto [left, right] = split(node->right, pos - leftSize - node->length);
+        return {withChildren(node, node->left, left), right};
+    }
+
+    // 位置落在片段内部，把片段一分为二
+    size_t cut = pos - leftSize;
+    NodePtr head = makeLeaf(node->buffer, node->offset, cut);
+    NodePtr tail = makeLeaf(node->buffer, node->offset + cut, node->length - cut);
+    return {merge(node->left, head), merge(tail, node->right)};
+}
+
+// 把文本放入新的共享缓冲区并切成不超过 kMaxPiece 的片段
+NodePtr build(std::string_view text) {
+    if (text.empty()) {
+        return nullptr;
+    }
+    auto buffer = std::make_shared<const std::string>(text);
+    NodePtr root;
+    for (size_t offset = 0; offset < buffer->size(); offset += kMaxPiece) {
+        root = merge(root, makeLeaf(buffer, offset, std::min(kMaxPiece, buffer->size() - offset)));
+    }
+    return root;
+}
+
+void appendRange(const NodePtr& node, size_t from, size_t to, std::string& out) {
+    if (!node || from >= to) {
+        return;
+    }
+    size_t leftSize = sizeOf(node->left);
+    if (from < leftSize) {
+        appendRange(node->left, from, std::min(to, leftSize), out);
+    }
+    size_t pieceStart = leftSize;
+    size_t pieceEnd = leftSize + node->length;
+    if (from < pieceEnd && to > pieceStart) {
+        size_t begin = std::max(from, pieceStart) - pieceStart;
+        size_t end = std::min(to, pieceEnd) - pieceStart;
+        out.append(node->data() + begin, end - begin);
+    }
+    if (to > pieceEnd) {
+        appendRange(node->right, from > pieceEnd ? from - pieceEnd : 0, to - pieceEnd, out);
+    }
+}
+
+// 按顺序访问 [from, to) 覆盖的片段内容，不复制；visit 返回 false 时停止
+template <typename Visit>
+bool visitRange(const Node* node, size_t from, size_t to, Visit& visit) {
+    while (node && from < to) {
+        size_t leftSize = sizeOf(node->left);
+        if (from < leftSize && !visitRange(node->left.get(), from, std::min(to, leftSize), visit)) {
+            return false;
+        }
+        size_t pieceEnd = leftSize + node->length;
+        if (from < pieceEnd && to > leftSize) {
+            size_t begin = std::max(from, leftSize) - leftSize;
+            size_t end = std::min(to, pieceEnd) - leftSize;
+            if (!visit(node->data() + begin, end - begin)) {
+                return false;
+            }
+        }
+        if (to <= pieceEnd) {
+            return true;
+        }
+        from = from > pieceEnd ? from - pieceEnd : 0;
+        to -= pieceEnd;
+        node = node->right.get();
+    }
+    return true;
+}
+
+char byteAt(const Node* node, size_t pos) {
+    while (node) {
+        size_t leftSize = sizeOf(node->left);
+        if (pos < leftSize) {
+            node = node->left.get();
+            continue;
+        }
+        pos -= leftSize;
+        if (pos < node->length) {
+            return node->data()[pos];
+        }
+        pos -= node->length;
+        node = node->right.get();
+    }
+    return '\0';
+}
+
+bool isContinuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+void visitChunks(const Node* node, const std::function<void(std::string_view)>& visit) {
+    while (node) {
+        visitChunks(node->left.get(), visit);
+        visit(std::string_view(node->data(), node->length));
+        node = node->right.get();
+    }
+}
+
+} // namespace
+
+Document::Document(std::string languageId, NodePtr root, int version)
+    : languageId(std::move(languageId)), root(std::move(root)), version(version) {}
+
+std::shared_ptr<const Document> Document::create(std::string languageId, std::string_view text, int version) {
+    return std::shared_ptr<const Document>(new Document(std::move(languageId), build(text), version));
+}
+
+std::shared_ptr<const Document> Document::edit(const TextRange& range, std::string_view text, int version,
+                                               PositionEncoding encoding) const {
+    size_t start = offsetAt(range.start, encoding);
+    size_t end = offsetAt(range.end, encoding);
+    if (start > end) {
+        return nullptr;
+    }
+    auto [head, rest] = split(root, start);
+    auto [removed, tail] = split(rest, end - start);
+    NodePtr updated = merge(merge(head, build(text)), tail);
+    return std::shared_ptr<const Document>(new Document(languageId, std::move(updated), version));
+}
+
+void Document::forEachChunk(const std::function<void(std::string_view)>& visit) const {
+    visitChunks(root.get(), visit);
+}
+
+std::string Document::text() const {
+    return substr(0, size());
+}
+
+std::string Document::substr(size_t offset, size_t length) const {
+    std::string out;
+    size_t end = std::min(size(), offset + std::min(length, size()));
+    if (offset < end) {
+        out.reserve(end - offset);
+        appendRange(root, offset, end, out);
+    }
+    return out;
+}
+
+size_t Document::size() const {
+    return sizeOf(root);
+}
+
+size_t Document::lineCount() const {
+    return linesOf(root) + 1;
+}
+
+size_t Document::lineStart(size_t line) const {
+    if (line == 0) {
+        return 0;
+    }
+    if (line > linesOf(root)) {
+        return size();
+    }
+
+    // 沿换行数下降，找到第 line 个换行符之后的位置
+    size_t base = 0;
+    const Node* node = root.get();
+    while (node) {
+        size_t leftLines = linesOf(node->left);
+        if (line <= leftLines) {
+            node = node->left.get();
+            continue;
+        }
+        line -= leftLines;
+        base += sizeOf(node->left);
+        if (line <= node->pieceLines()) {
+            return base + (*node->newlines)[line - 1] + 1;
+        }
+        line -= node->pieceLines();
+        base += node->length;
+        node = node->right.get();
+    }
+    return size();
+}
+
+size_t Document::lineOf(size_t offset) const {
+    size_t line = 0;
+    const Node* node = root.get();
+    while (node) {
+        size_t leftSize = sizeOf(node->left);
+        if (offset <= leftSize) {
+            node = node->left.get();
+            continue;
+        }
+        line += linesOf(node->left);
+        offset -= leftSize;
+        if (offset <= node->length) {
+            const std::vector<uint32_t>& newlines = *node->newlines;
+            return line + static_cast<size_t>(std::lower_bound(newlines.begin(), newlines.end(), offset) -
+                                              newlines.begin());
+        }
+        line += node->pieceLines();
+        offset -= node->length;
+        node = node->right.get();
+    }
+    return line;
+}
+
+size_t Document::offsetAt(const TextPosition& position, PositionEncoding encoding) const {
+    if (position.line < 0) {
+        return 0;
+    }
+    size_t line = static_cast<size_t>(position.line);
+    size_t start = lineStart(line);
+    if (line >= lineCount()) {
+        return start;
+    }
+
+    // 行尾的换行符不计入列号；最后一行没有换行符
+    size_t end = lineStart(line + 1);
+    if (line + 1 < lineCount()) {
+        --end;
+        if (end > start && byteAt(root.get(), end - 1) == '\r') {
+            --end;
+        }
+    }
+    if (position.character <= 0) {
+        return start;
+    }
+    size_t target = static_cast<size_t>(position.character);
+
+    if (encoding == PositionEncoding::Utf8) {
+        // 列号落在字符中间时退回到字符开头
+        size_t offset = start + std::min(target, end - start);
+        while (offset > start && offset < end && isContinuation(byteAt(root.get(), offset))) {
+            --offset;
+        }
+        return offset;
+    }
+
+    // 逐个片段累计 UTF-16 单元，不复制行内容；跨片段的字符以首字节所在片段计数
+    size_t units = 0;
+    size_t pieceStart = start;
+    size_t result = end;
+    auto advance = [&](const char* data, size_t length) {
+        size_t i = 0;
+        while (i < length && isContinuation(data[i])) {
+            ++i;
+        }
+        if (units >= target) {
+            if (i < length) {
+                result = pieceStart + i;
+                return false;
+            }
+            pieceStart += length;
+            return true;
+        }
+        size_t used = i + PositionCodec::offsetOf(data + i, length - i, static_cast<int>(target - units), encoding);
+        if (used < length) {
+            result = pieceStart + used;
+            return false;
+        }
+        units += PositionCodec::utf16Length(data + i, length - i);
+        pieceStart += length;
+        return true;
+    };
+    visitRange(root.get(), start, end, advance);
+    return result;
+}
+
+TextPosition Document::positionAt(size_t offset, PositionEncoding encoding) const {
+    offset = std::min(offset, size());
+    size_t line = lineOf(offset);
+    int column = 0;
+    auto count = [&](const char* data, size_t length) {
+        column += PositionCodec::columnOf(data, length, encoding);
+        return true;
+    };
+    visitRange(root.get(), lineStart(line), offset, count);
+    return {static_cast<int>(line), column};
+}
+
+DocumentSnapshot DocumentStore::open(const std::string& uri, const std::string& languageId, std::string_view text) {
+    DocumentSnapshot document = Document::create(languageId, text, 1);
+    open(uri, document);
+    return document;
+}
+
+void DocumentStore::open(const std::string& uri, DocumentSnapshot document) {
+    std::lock_guard<std::mutex> lock(mutex);
+    documents[uri] = std::move(document);
+}
+
+DocumentSnapshot DocumentStore::replace(const std::string& uri, std::string_view text, int version) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = documents.find(uri);
+    if (it == documents.end()) {
+        return nullptr;
+    }
+    it->second = Document::create(it->second->getLanguageId(), text, version);
+    return it->second;
+}
+
+DocumentSnapshot DocumentStore::applyEdit(const std::string& uri, const TextRange& range, std::string_view text,
+                                          PositionEncoding encoding) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = documents.find(uri);
+    if (it == documents.end()) {
+        return nullptr;
+    }
+    DocumentSnapshot updated = it->second->edit(range, text, it->second->getVersion() + 1, encoding);
+    if (updated) {
+        it->second = updated;
+    }
+    return updated;
+}
+
+DocumentSnapshot DocumentStore::get(const std::string& uri) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = documents.find(uri);
+    return it != documents.end() ? it->second : nullptr;
+}
+
+bool DocumentStore::close(const std::string& uri) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return documents.erase(uri) > 0;
+}
+
+std::vector<std::pair<std::string, DocumentSnapshot>> DocumentStore::all() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::vector<std::pair<std::string, DocumentSnapshot>>(documents.begin(), documents.end());
+}
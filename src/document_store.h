@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "text_diff.h"
+#include "position_codec.h"
+
+// LSP 范围，左闭右开
+struct TextRange {
+    TextPosition start;
+    TextPosition end;
+};
+
+// 不可变的文档内容
+// 文本保存为片段表：每个片段引用一块共享的只读缓冲区，片段组织成持久化 treap，
+// 子树上记录字节数和换行数，同时充当随编辑增量更新的行首索引。
+// 编辑只复制从根到修改点的路径，期望 O(log n)，旧版本保持不变，可以被其他线程继续读取
+class Document {
+public:
+    // 创建文档，文本按固定大小切成片段
+    static std::shared_ptr<const Document> create(std::string languageId, std::string_view text, int version);
+
+    // 应用一处编辑，返回新版本的文档；起点在终点之后时返回空指针
+    std::shared_ptr<const Document> edit(const TextRange& range, std::string_view text, int version,
+                                         PositionEncoding encoding = PositionEncoding::Utf16) const;
+
+    // 拼出完整文本
+    std::string text() const;
+
+    // 按顺序访问各片段的内容，不拼接整篇文本
+    void forEachChunk(const std::function<void(std::string_view)>& visit) const;
+
+    // 取出 [offset, offset + length) 的文本
+    std::string substr(size_t offset, size_t length) const;
+
+    // LSP 位置对应的字节偏移；行号超出时为文末，列号超出时为行尾（不含换行符）
+    size_t offsetAt(const TextPosition& position, PositionEncoding encoding = PositionEncoding::Utf16) const;
+
+    // 字节偏移对应的 LSP 位置，超出时为文末
+    TextPosition positionAt(size_t offset, PositionEncoding encoding = PositionEncoding::Utf16) const;
+
+    size_t size() const;
+    size_t lineCount() const;
+    int getVersion() const { return version; }
+    const std::string& getLanguageId() const { return languageId; }
+
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+private:
+    Document(std::string languageId, NodePtr root, int version);
+
+    // 第 line 行行首的字节偏移，line 超出时返回文末
+    size_t lineStart(size_t line) const;
+
+    // 偏移之前的换行数，即偏移所在的行号
+    size_t lineOf(size_t offset) const;
+
+    std::string languageId;
+    NodePtr root;
+    int version;
+};
+
+using DocumentSnapshot = std::shared_ptr<const Document>;
+
+// 已打开文档的存储
+// 每个 URI 保存当前快照，读者取走快照后不受后续编辑影响
+class DocumentStore {
+public:
+    // 打开文档，版本为 1
+    DocumentSnapshot open(const std::string& uri, const std::string& languageId, std::string_view text);
+
+    // 打开调用方预先构建的快照，构建片段表不占用存储的锁
+    void open(const std::string& uri, DocumentSnapshot document);
+
+    // 替换全文并使用调用方给出的版本，文档未打开时返回空指针
+    DocumentSnapshot replace(const std::string& uri, std::string_view text, int version);
+
+    // 应用一处编辑，版本自动加一；文档未打开或范围非法时返回空指针
+    DocumentSnapshot applyEdit(const std::string& uri, const TextRange& range, std::string_view text,
+                               PositionEncoding encoding = PositionEncoding::Utf16);
+
+    // 当前快照，未打开时返回空指针
+    DocumentSnapshot get(const std::string& uri) const;
+
+    // 关闭文档，未打开时返回 false
+    bool close(const std::string& uri);
+
+    // 所有已打开文档的快照
+    std::vector<std::pair<std::string, DocumentSnapshot>> all() const;
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, DocumentSnapshot> documents;
+};
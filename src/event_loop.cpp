@@ -0,0 +1,217 @@
+#include "event_loop.h"
+#include <cerrno>
+#include <cstdint>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+const int kMaxEvents = 64;
+}
+
+EventLoop::EventLoop()
+    : epollFd(epoll_create1(EPOLL_CLOEXEC)),
+      wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      stopRequested(false),
+      loopThread(std::thread::id()),
+      nextTimerId(1) {
+    if (!isValid()) {
+        std::cerr << "创建事件循环失败" << std::endl;
+        return;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+}
+
+EventLoop::~EventLoop() {
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+}
+
+bool EventLoop::addFd(int fd, uint32_t events, IoHandler handler) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        handlers[fd] = std::make_shared<IoHandler>(std::move(handler));
+    }
+
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        handlers.erase(fd);
+        return false;
+    }
+    return true;
+}
+
+bool EventLoop::modifyFd(int fd, uint32_t events) {
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::removeFd(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    std::lock_guard<std::mutex> lock(mutex);
+    handlers.erase(fd);
+}
+
+uint64_t EventLoop::addTimer(std::chrono::milliseconds delay, Task task) {
+    uint64_t timerId;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        timerId = nextTimerId++;
+        timerQueue.emplace(Clock::now() + delay, timerId);
+        timers.emplace(timerId, std::move(task));
+    }
+    // 新定时器可能早于循环当前的等待时间
+    if (!isInLoopThread()) {
+        wakeup();
+    }
+    return timerId;
+}
+
+bool EventLoop::cancelTimer(uint64_t timerId) {
+    // 队列中的条目在到期时惰性丢弃
+    std::lock_guard<std::mutex> lock(mutex);
+    return timers.erase(timerId) > 0;
+}
+
+void EventLoop::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        posted.push_back(std::move(task));
+    }
+    wakeup();
+}
+
+void EventLoop::stop() {
+    stopRequested = true;
+    wakeup();
+}
+
+void EventLoop::clearStop() {
+    stopRequested = false;
+}
+
+bool EventLoop::isInLoopThread() const {
+    return loopThread.load() == std::this_thread::get_id();
+}
+
+void EventLoop::wakeup() {
+    uint64_t one = 1;
+    ssize_t n = write(wakeFd, &one, sizeof(one));
+    (void)n;
+}
+
+void EventLoop::drainWakeup() {
+    uint64_t value;
+    ssize_t n = read(wakeFd, &value, sizeof(value));
+    (void)n;
+}
+
+int EventLoop::nextTimeoutMs() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!posted.empty()) {
+        return 0;
+    }
+    // 清掉队首已取消的定时器
+    while (!timerQueue.empty() && timers.find(timerQueue.begin()->second) == timers.end()) {
+        timerQueue.erase(timerQueue.begin());
+    }
+    if (timerQueue.empty()) {
+        return -1;
+    }
+
+    auto remaining = timerQueue.begin()->first - Clock::now();
+    if (remaining <= Clock::duration::zero()) {
+        return 0;
+    }
+    // 向上取整，避免提前醒来后空转
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+}
+
+void EventLoop::runExpiredTimers() {
+    std::vector<Task> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = Clock::now();
+        while (!timerQueue.empty() && timerQueue.begin()->first <= now) {
+            auto it = timers.find(timerQueue.begin()->second);
+            if (it != timers.end()) {
+                expired.push_back(std::move(it->second));
+                timers.erase(it);
+            }
+            timerQueue.erase(timerQueue.begin());
+        }
+    }
+    for (auto& task : expired) {
+        task();
+    }
+}
+
+void EventLoop::runPostedTasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.swap(posted);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void EventLoop::run() {
+    if (!isValid()) {
+        return;
+    }
+    loopThread = std::this_thread::get_id();
+
+    struct epoll_event events[kMaxEvents];
+    while (!stopRequested) {
+        int n = epoll_wait(epollFd, events, kMaxEvents, nextTimeoutMs());
+        if (n < 0 && errno != EINTR) {
+            std::cerr << "epoll_wait失败: " << errno << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n && !stopRequested; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                drainWakeup();
+                continue;
+            }
+
+            // 复制一份处理函数，允许回调中注销自己
+            std::shared_ptr<IoHandler> handler;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = handlers.find(fd);
+                if (it != handlers.end()) {
+                    handler = it->second;
+                }
+            }
+            if (handler) {
+                (*handler)(events[i].events);
+            }
+        }
+
+        if (!stopRequested) {
+            runPostedTasks();
+            runExpiredTimers();
+        }
+    }
+
+    loopThread = std::thread::id();
+    stopRequested = false;
+}
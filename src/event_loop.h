@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 基于 epoll 的事件循环
+// fd 就绪事件、定时器和其他线程投递的任务都在循环线程中执行；
+// 跨线程操作通过 eventfd 唤醒，空闲时一直阻塞在 epoll_wait 上
+class EventLoop {
+public:
+    using Task = std::function<void()>;
+    using IoHandler = std::function<void(uint32_t events)>;
+    using Clock = std::chrono::steady_clock;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool isValid() const { return epollFd >= 0 && wakeFd >= 0; }
+
+    // 注册 fd，events 为 EPOLLIN/EPOLLOUT 等
+    bool addFd(int fd, uint32_t events, IoHandler handler);
+
+    // 修改已注册 fd 关注的事件
+    bool modifyFd(int fd, uint32_t events);
+
+    // 取消注册 fd，不会关闭它
+    void removeFd(int fd);
+
+    // 添加一次性定时器，返回定时器 ID
+    uint64_t addTimer(std::chrono::milliseconds delay, Task task);
+
+    // 取消定时器，已触发或不存在时返回 false
+    bool cancelTimer(uint64_t timerId);
+
+    // 投递任务到循环线程执行
+    void post(Task task);
+
+    // 在当前线程运行事件循环直到 stop
+    void run();
+
+    // 请求退出事件循环，可在任意线程调用
+    void stop();
+
+    // 清除循环退出后才到达的停止请求，只能在循环未运行时调用
+    void clearStop();
+
+    bool isInLoopThread() const;
+
+private:
+    void wakeup();
+    void drainWakeup();
+
+    // 距离最近一个定时器到期的毫秒数，没有定时器时返回 -1
+    int nextTimeoutMs();
+
+    void runExpiredTimers();
+    void runPostedTasks();
+
+    int epollFd;
+    int wakeFd;
+    std::atomic<bool> stopRequested;
+    std::atomic<std::thread::id> loopThread;
+
+    std::mutex mutex;
+    std::unordered_map<int, std::shared_ptr<IoHandler>> handlers;
+    std::vector<Task> posted;
+    uint64_t nextTimerId;
+    std::multimap<Clock::time_point, uint64_t> timerQueue;
+    std::unordered_map<uint64_t, Task> timers;
+};
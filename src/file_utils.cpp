@@ -1,18 +1,15 @@
 #include "file_utils.h"
+#include "file_view.h"
 #include <iostream>
-#include <fstream>
 #include <algorithm>
 
 std::string FileUtils::readFile(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
+    FileView file;
+    if (!file.open(path)) {
         std::cerr << "Failed to open file: " << path << std::endl;
         return "";
     }
-    
-    std::string content((std::istreambuf_iterator<char>(file)),
-                         std::istreambuf_iterator<char>());
-    return content;
+    return std::string(file.view());
 }
 
 json FileUtils::createSourcePathConfig(const std::string& srcPath) {
@@ -35,6 +32,16 @@ std::string FileUtils::normalizePath(const std::string& path) {
     return normalized;
 }
 
+bool FileUtils::hasExtension(const std::string& path, const std::vector<std::string>& extensions) {
+    for (const std::string& extension : extensions) {
+        if (path.size() >= extension.size() &&
+            path.compare(path.size() - extension.size(), extension.size(), extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 std::string FileUtils::pathToUri(const std::string& path) {
     std::string normalized = normalizePath(path);
     
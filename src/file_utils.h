@@ -16,6 +16,9 @@ public:
 
     // 统一路径格式
     static std::string normalizePath(const std::string& path);
+
+    // 路径是否以 extensions 中的某个扩展名结尾
+    static bool hasExtension(const std::string& path, const std::vector<std::string>& extensions);
     
     // 设置项目源代码路径
     static json createSourcePathConfig(const std::string& srcPath);
@@ -0,0 +1,95 @@
+#include "file_view.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+FileView::~FileView() {
+    release();
+}
+
+FileView::FileView(FileView&& other) noexcept
+    : mapped(other.mapped), mappedLength(other.mappedLength), buffer(std::move(other.buffer)) {
+    other.mapped = nullptr;
+    other.mappedLength = 0;
+}
+
+FileView& FileView::operator=(FileView&& other) noexcept {
+    if (this != &other) {
+        release();
+        mapped = other.mapped;
+        mappedLength = other.mappedLength;
+        buffer = std::move(other.buffer);
+        other.mapped = nullptr;
+        other.mappedLength = 0;
+    }
+    return *this;
+}
+
+void FileView::release() {
+    if (mapped) {
+        munmap(const_cast<char*>(mapped), mappedLength);
+        mapped = nullptr;
+        mappedLength = 0;
+    }
+    buffer.clear();
+}
+
+bool FileView::open(const std::string& path) {
+    release();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+
+    if (size >= kMapThreshold) {
+        void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            // 内容通常只顺序读一遍，提示内核积极预读
+            madvise(address, size, MADV_SEQUENTIAL);
+            ::close(fd);
+            mapped = static_cast<const char*>(address);
+            mappedLength = size;
+            return true;
+        }
+    }
+
+    // 按 fstat 的大小一次分配，文件在读取期间变化时以实际读到的为准
+    buffer.resize(size);
+    size_t total = 0;
+    while (total < buffer.size()) {
+        ssize_t n = ::read(fd, &buffer[total], buffer.size() - total);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            ::close(fd);
+            buffer.clear();
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += static_cast<size_t>(n);
+    }
+    buffer.resize(total);
+    if (total == size) {
+        // fstat 之后追加的内容
+        char extra[4096];
+        ssize_t n;
+        while ((n = ::read(fd, extra, sizeof(extra))) > 0 || (n < 0 && errno == EINTR)) {
+            if (n > 0) {
+                buffer.append(extra, static_cast<size_t>(n));
+            }
+        }
+    }
+    ::close(fd);
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// 只读文件视图
+// 大文件用 mmap 映射，不经过用户态缓冲区；小文件或无法映射时用 read 一次读入。
+// 映射期间文件被其他进程截断时访问会触发 SIGBUS，视图应尽快用完释放
+class FileView {
+public:
+    // 不小于该大小的文件使用 mmap
+    static constexpr size_t kMapThreshold = 64 * 1024;
+
+    FileView() = default;
+    ~FileView();
+
+    FileView(FileView&& other) noexcept;
+    FileView& operator=(FileView&& other) noexcept;
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    // 打开文件，失败时返回 false，视图为空
+    bool open(const std::string& path);
+
+    const char* data() const { return mapped ? mapped : buffer.data(); }
+    size_t size() const { return mapped ? mappedLength : buffer.size(); }
+    std::string_view view() const { return {data(), size()}; }
+    bool isMapped() const { return mapped != nullptr; }
+
+private:
+    void release();
+
+    const char* mapped = nullptr;
+    size_t mappedLength = 0;
+    std::string buffer;
+};
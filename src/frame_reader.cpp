@@ -0,0 +1,159 @@
+#include "frame_reader.h"
+#include "transport.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <strings.h>
+
+namespace {
+// 单次 read 的最小空闲空间
+const size_t kMinRead = 16 * 1024;
+// 消息头最大长度，超过仍未找到结束符视为非法
+const size_t kMaxHeader = 8 * 1024;
+// 单帧消息体上限
+const size_t kMaxContentLength = 512u * 1024 * 1024;
+}
+
+FrameReader::FrameReader(Transport* transport, size_t initialCapacity)
+    : transport(transport), buffer(initialCapacity), head(0), tail(0), pending(0), eof(false) {}
+
+void FrameReader::reset(Transport* newTransport) {
+    transport = newTransport;
+    head = tail = pending = 0;
+    eof = false;
+}
+
+long FrameReader::parseHeader(const char* begin, const char* end, size_t& contentLength) {
+    static const char terminator[] = "\r\n\r\n";
+    const char* headerEnd = std::search(begin, end, terminator, terminator + 4);
+    if (headerEnd == end) {
+        return 0;
+    }
+
+    // 逐行查找 Content-Length，其余头部字段忽略
+    bool found = false;
+    const char* line = begin;
+    while (line < headerEnd) {
+        const char* lineEnd = static_cast<const char*>(memchr(line, '\n', headerEnd - line));
+        if (!lineEnd) {
+            lineEnd = headerEnd;
+        }
+        if (lineEnd - line > 15 && strncasecmp(line, "Content-Length:", 15) == 0) {
+            const char* p = line + 15;
+            while (p < lineEnd && *p == ' ') {
+                ++p;
+            }
+            size_t value = 0;
+            bool digits = false;
+            while (p < lineEnd && *p >= '0' && *p <= '9') {
+                value = value * 10 + (*p - '0');
+                if (value > kMaxContentLength) {
+                    return -1;
+                }
+                digits = true;
+                ++p;
+            }
+            if (!digits) {
+                return -1;
+            }
+            contentLength = value;
+            found = true;
+        }
+        line = lineEnd + 1;
+    }
+
+    return found ? static_cast<long>(headerEnd - begin + 4) : -1;
+}
+
+bool FrameReader::hasFrame() const {
+    size_t contentLength = 0;
+    long headerLength = parseHeader(buffer.data() + head, buffer.data() + tail, contentLength);
+    return headerLength > 0 && tail - head >= headerLength + contentLength;
+}
+
+FrameReader::Status FrameReader::next(const char*& body, size_t& length) {
+    size_t available = tail - head;
+    size_t contentLength = 0;
+    long headerLength = parseHeader(buffer.data() + head, buffer.data() + tail, contentLength);
+
+    if (headerLength < 0) {
+        return Status::Error;
+    }
+    if (headerLength == 0) {
+        if (available > kMaxHeader) {
+            return Status::Error;
+        }
+        pending = 0;
+        return eof ? Status::Eof : Status::NeedMore;
+    }
+
+    size_t frameLength = headerLength + contentLength;
+    if (available < frameLength) {
+        pending = frameLength;
+        return eof ? Status::Eof : Status::NeedMore;
+    }
+
+    body = buffer.data() + head + headerLength;
+    length = contentLength;
+    head += frameLength;
+    pending = 0;
+    return Status::Frame;
+}
+
+void FrameReader::reserve(size_t minFree) {
+    if (head == tail) {
+        head = tail = 0;
+    }
+    if (buffer.size() - tail >= minFree) {
+        return;
+    }
+
+    // 把尚未消费的半帧挪到缓冲区开头，通常只有几 KB
+    if (head > 0) {
+        memmove(buffer.data(), buffer.data() + head, tail - head);
+        tail -= head;
+        head = 0;
+    }
+    if (buffer.size() - tail < minFree) {
+        buffer.resize(std::max(buffer.size() * 2, tail + minFree));
+    }
+}
+
+ssize_t FrameReader::fill() {
+    size_t buffered = tail - head;
+    size_t want = pending > buffered ? pending - buffered : 0;
+    reserve(std::max(want, kMinRead));
+
+    if (!transport) {
+        errno = EBADF;
+        return -1;
+    }
+
+    ssize_t n = transport->read(buffer.data() + tail, buffer.size() - tail);
+    if (n > 0) {
+        tail += n;
+    } else if (n == 0) {
+        eof = true;
+    }
+    return n;
+}
+
+FrameReader::Status FrameReader::readFrame(const char*& body, size_t& length) {
+    while (true) {
+        Status status = next(body, length);
+        if (status != Status::NeedMore) {
+            return status;
+        }
+        if (fill() < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return Status::Error;
+            }
+            // 等待数据到达
+            struct pollfd pfd = {transport->readFd(), POLLIN, 0};
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+                return Status::Error;
+            }
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <sys/types.h>
+
+class Transport;
+
+// LSP 帧解码器
+// 从传输层批量读取数据到可复用缓冲区，在缓冲区内原地查找消息头，
+// 一次 read 可以解出多帧，消息体以指针区间的形式直接交给解析器
+class FrameReader {
+public:
+    enum class Status {
+        Frame,     // 取出一帧完整消息
+        NeedMore,  // 缓冲区中的数据不足一帧
+        Eof,       // 对端已关闭
+        Error      // 读取失败或消息头非法
+    };
+
+    explicit FrameReader(Transport* transport = nullptr, size_t initialCapacity = 64 * 1024);
+
+    // 重新绑定传输层并清空缓冲区
+    void reset(Transport* transport);
+
+    // 从传输层读取一次数据，返回值与 read 相同
+    ssize_t fill();
+
+    // 尝试从缓冲区中取出下一帧，成功时 body/length 指向缓冲区内的消息体
+    // 指针在下一次调用 next/fill/readFrame 之前有效
+    Status next(const char*& body, size_t& length);
+
+    // 阻塞直到取出一帧或出错，暂无数据时在 readFd 上 poll 等待
+    Status readFrame(const char*& body, size_t& length);
+
+    // 缓冲区中是否已有一帧完整消息，用于在 select 之前判断
+    bool hasFrame() const;
+
+private:
+    // 解析消息头，返回头部长度；数据不足返回 0，非法返回 -1
+    static long parseHeader(const char* begin, const char* end, size_t& contentLength);
+
+    // 保证缓冲区尾部至少有 minFree 字节空闲
+    void reserve(size_t minFree);
+
+    Transport* transport;
+    std::vector<char> buffer;
+    size_t head;     // 未消费数据起点
+    size_t tail;     // 已写入数据终点
+    size_t pending;  // 正在接收的帧的总长度，未知时为 0
+    bool eof;
+};
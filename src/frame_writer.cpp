@@ -0,0 +1,125 @@
+#include "frame_writer.h"
+#include "transport.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+// "Content-Length: " + 20 位数字 + "\r\n\r\n"
+const size_t kHeaderCapacity = 48;
+// 单次 writev 的 iovec 数量上限
+const int kMaxIov = 1024;
+}
+
+FrameWriter::FrameWriter(Transport* transport)
+    : transport(transport), wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), batching(false) {}
+
+FrameWriter::~FrameWriter() {
+    if (wakeFd >= 0) {
+        ::close(wakeFd);
+    }
+}
+
+void FrameWriter::reset(Transport* newTransport) {
+    transport = newTransport;
+    batching = false;
+    queued.clear();
+    uint64_t value;
+    while (::read(wakeFd, &value, sizeof(value)) < 0 && errno == EINTR) {
+    }
+}
+
+void FrameWriter::interrupt() {
+    uint64_t value = 1;
+    while (::write(wakeFd, &value, sizeof(value)) < 0 && errno == EINTR) {
+    }
+}
+
+size_t FrameWriter::formatHeader(char* out, size_t contentLength) {
+    int n = snprintf(out, kHeaderCapacity, "Content-Length: %zu\r\n\r\n", contentLength);
+    return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+bool FrameWriter::writeAll(struct iovec* iov, int count) {
+    if (!transport) {
+        return false;
+    }
+
+    while (count > 0) {
+        ssize_t n = transport->writev(iov, std::min(count, kMaxIov));
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+            // 对端不再读取时会一直不可写，关闭连接时由 interrupt 唤醒
+            struct pollfd pfds[2] = {{transport->writeFd(), POLLOUT, 0}, {wakeFd, POLLIN, 0}};
+            if (poll(pfds, 2, -1) < 0 && errno != EINTR) {
+                return false;
+            }
+            if (pfds[1].revents & POLLIN) {
+                errno = ECANCELED;
+                return false;
+            }
+            continue;
+        }
+
+        // 跳过已经写完的 iovec，调整写了一半的那个
+        size_t written = static_cast<size_t>(n);
+        while (count > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+bool FrameWriter::writeFrame(std::string body) {
+    if (batching) {
+        queued.push_back(std::move(body));
+        return true;
+    }
+
+    char header[kHeaderCapacity];
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = formatHeader(header, body.size());
+    iov[1].iov_base = const_cast<char*>(body.data());
+    iov[1].iov_len = body.size();
+    return writeAll(iov, 2);
+}
+
+void FrameWriter::beginBatch() {
+    batching = true;
+}
+
+bool FrameWriter::flush() {
+    batching = false;
+    if (queued.empty()) {
+        return true;
+    }
+
+    // 所有消息头放在一块连续内存中，避免逐帧分配
+    std::vector<char> headers(queued.size() * kHeaderCapacity);
+    std::vector<struct iovec> iov(queued.size() * 2);
+    for (size_t i = 0; i < queued.size(); ++i) {
+        char* header = headers.data() + i * kHeaderCapacity;
+        iov[2 * i].iov_base = header;
+        iov[2 * i].iov_len = formatHeader(header, queued[i].size());
+        iov[2 * i + 1].iov_base = const_cast<char*>(queued[i].data());
+        iov[2 * i + 1].iov_len = queued[i].size();
+    }
+
+    bool ok = writeAll(iov.data(), static_cast<int>(iov.size()));
+    queued.clear();
+    return ok;
+}
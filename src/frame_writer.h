@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct iovec;
+class Transport;
+
+// LSP 帧编码器
+// 消息头格式化到栈上的小缓冲区，与消息体一起通过一次 writev 写出，
+// 批量模式下多帧排队后在一次系统调用中发送
+class FrameWriter {
+public:
+    explicit FrameWriter(Transport* transport = nullptr);
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    // 重新绑定传输层并丢弃排队中的帧，同时清除 interrupt 标记
+    void reset(Transport* transport);
+
+    // 唤醒阻塞在 poll 上的写入并使其失败；可从其他线程调用，直到下一次 reset 前的写入都会失败
+    void interrupt();
+
+    // 发送一帧；批量模式下只排队，等待 flush
+    bool writeFrame(std::string body);
+
+    // 进入批量模式
+    void beginBatch();
+
+    // 发送所有排队的帧并退出批量模式
+    bool flush();
+
+    bool isBatching() const { return batching; }
+
+private:
+    // 将 Content-Length 头写入 out，返回长度
+    static size_t formatHeader(char* out, size_t contentLength);
+
+    // 写出全部 iovec，处理部分写入，传输层暂不可写时 poll 等待，被 interrupt 时返回 false
+    bool writeAll(struct iovec* iov, int count);
+
+    Transport* transport;
+    int wakeFd;  // interrupt 使用的 eventfd
+    bool batching;
+    std::vector<std::string> queued;
+};
@@ -0,0 +1,170 @@
+#include "json_escape.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// U+FFFD 的 UTF-8 编码
+const char kReplacement[] = "\xEF\xBF\xBD";
+
+bool needsEscape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\' || c >= 0x80;
+}
+
+// 第一个需要转义或校验的字节的位置，没有时返回 length
+size_t findSpecial(const char* data, size_t length) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    // 无符号 c < 0x20 等价于 max(c, 0x1F) == 0x1F
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while (i + 16 <= length) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(block, control), control));
+        // 最高位为 1 的字节是多字节字符的一部分，movemask 直接取出
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(hit, block)));
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+        i += 16;
+    }
+#endif
+    while (i < length && !needsEscape(static_cast<unsigned char>(data[i]))) {
+        ++i;
+    }
+    return i;
+}
+
+// 校验 data 开头的多字节字符，返回其长度；不合法时返回 0，invalidAt 为出错字节的位置；
+// 合法但被截断时返回 0，invalidAt 为 length
+size_t checkSequence(const unsigned char* data, size_t length, size_t& invalidAt) {
+    unsigned char lead = data[0];
+    size_t size;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        size = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        size = 3;
+        // 排除过长编码和代理区
+        if (lead == 0xE0) {
+            low = 0xA0;
+        } else if (lead == 0xED) {
+            high = 0x9F;
+        }
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        size = 4;
+        // 排除过长编码和超过 U+10FFFF 的码点
+        if (lead == 0xF0) {
+            low = 0x90;
+        } else if (lead == 0xF4) {
+            high = 0x8F;
+        }
+    } else {
+        invalidAt = 1;
+        return 0;
+    }
+
+    for (size_t j = 1; j < size; ++j) {
+        if (j >= length) {
+            invalidAt = length;
+            return 0;
+        }
+        if (data[j] < low || data[j] > high) {
+            invalidAt = j;
+            return 0;
+        }
+        low = 0x80;
+        high = 0xBF;
+    }
+    return size;
+}
+
+// 转义 text 追加到 out，返回处理的字节数；final 为 false 时末尾被截断的字符不处理
+size_t escape(std::string& out, std::string_view text, bool final) {
+    static const char kHex[] = "0123456789abcdef";
+    const char* data = text.data();
+    size_t length = text.size();
+    size_t i = 0;
+    while (i < length) {
+        size_t run = findSpecial(data + i, length - i);
+        out.append(data + i, run);
+        i += run;
+        if (i == length) {
+            break;
+        }
+
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c >= 0x80) {
+            size_t invalidAt = 0;
+            size_t size = checkSequence(reinterpret_cast<const unsigned char*>(data + i), length - i, invalidAt);
+            if (size > 0) {
+                out.append(data + i, size);
+                i += size;
+            } else if (i + invalidAt == length && !final) {
+                return i;
+            } else {
+                // 与 dump 的 error_handler_t::replace 相同：不合法的序列替换为一个 U+FFFD，
+                // 出错的字节若不是首字节则重新作为新字符的开头处理
+                out.append(kReplacement, 3);
+                i += invalidAt;
+            }
+            continue;
+        }
+
+        ++i;
+        switch (c) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default: {
+                char escaped[] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]};
+                out.append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+    return length;
+}
+
+} // namespace
+
+void JsonEscape::append(std::string& out, std::string_view text) {
+    escape(out, text, true);
+}
+
+void JsonEscape::appendQuoted(std::string& out, std::string_view text) {
+    out.push_back('"');
+    append(out, text);
+    out.push_back('"');
+}
+
+void JsonEscape::Stream::append(std::string_view chunk) {
+    if (!carry.empty()) {
+        // 上一块末尾被截断的字符最多还缺 3 个字节，拼上本块开头后单独处理
+        std::string joined = carry;
+        joined.append(chunk.substr(0, 3));
+        size_t used = escape(out, joined, false);
+        if (used < carry.size()) {
+            // 本块太短，字符仍不完整
+            carry = joined.substr(used);
+            return;
+        }
+        chunk.remove_prefix(used - carry.size());
+        carry.clear();
+    }
+    size_t used = escape(out, chunk, false);
+    carry.assign(chunk.substr(used));
+}
+
+void JsonEscape::Stream::finish() {
+    escape(out, carry, true);
+    carry.clear();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// JSON 字符串转义，直接追加到输出缓冲区
+// 用 SSE2 按 16 字节查找需要处理的字节（引号、反斜杠、控制字符、非 ASCII），其余字节整段复制。
+// 输出与 nlohmann::json::dump 使用 error_handler_t::replace 时相同：不合法的 UTF-8 替换为 U+FFFD
+class JsonEscape {
+public:
+    // 追加 text 转义后的内容，不含两侧引号
+    static void append(std::string& out, std::string_view text);
+
+    // 追加带引号的 JSON 字符串
+    static void appendQuoted(std::string& out, std::string_view text);
+
+    // 分块追加同一个字符串，块边界截断的多字节字符与下一块拼接后再校验
+    class Stream {
+    public:
+        explicit Stream(std::string& out) : out(out) {}
+
+        void append(std::string_view chunk);
+
+        // 输入结束，末尾不完整的字符替换为 U+FFFD
+        void finish();
+
+    private:
+        std::string& out;
+        std::string carry;
+    };
+};
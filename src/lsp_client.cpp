@@ -1,133 +1,82 @@
 #include "lsp_client.h"
 #include "file_utils.h"
+#include "file_view.h"
+#include "json_escape.h"
 #include <iostream>
 #include <sstream>
 #include <cstdio>
 #include <thread>
 #include <chrono>
 #include <cstring> // For memcpy
-
-#ifdef _WIN32
-#include <windows.h>
-#include <fcntl.h>
-#include <io.h>
-#else
+#include <cerrno>
 #include <unistd.h>
-// Add network-related headers for Linux
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
-#endif
+#include <poll.h>
+#include <sys/epoll.h>
 
-LSPClient::LSPClient() : requestId(1), serverIn(nullptr), serverOut(nullptr) {}
+LSPClient::LSPClient()
+    : watcher(loop), requestId(1), isRunning(false), traceMessages(false), requestTimeoutMs(60000), deadlineTimerId(0), changeDebounceMs(200),
+      textSyncKind(kSyncFull), positionEncoding(PositionEncoding::Utf16), reconnecting(false), closingSession(false), heartbeatEnabled(false), probeTimerId(0),
+      sessionState(SessionState::Disconnected), configuration(json::object()) {}
 
 LSPClient::~LSPClient() {
     shutdown();
+    stopReconnect();
+    if (listenerThread.joinable()) {
+        listenerThread.join();
+    }
 }
 bool LSPClient::initialize(const std::string& serverPath) {
-#ifdef _WIN32
-    SECURITY_ATTRIBUTES sa;
-    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-    sa.bInheritHandle = TRUE;
-    sa.lpSecurityDescriptor = NULL;
-
-    HANDLE hChildStdinRd, hChildStdinWr, hChildStdoutRd, hChildStdoutWr;
-
-    // 创建管道
-    if (!CreatePipe(&hChildStdinRd, &hChildStdinWr, &sa, 0) ||
-        !CreatePipe(&hChildStdoutRd, &hChildStdoutWr, &sa, 0)) {
-        std::cerr << "Failed to create pipes" << std::endl;
-        return false;
-    }
+    // 启动服务器进程，通过标准输入输出通信；服务器进程退出后重新启动
+    return connectWith([serverPath]() -> std::unique_ptr<Transport> {
+        auto pipeTransport = PipeTransport::spawn({"java", "-jar", serverPath, "--stdio"});
+        if (!pipeTransport) {
+            std::cerr << "Failed to open server pipes" << std::endl;
+        }
+        return pipeTransport;
+    });
+}
 
-    // 确保子进程不会继承写入端
-    SetHandleInformation(hChildStdinWr, HANDLE_FLAG_INHERIT, 0);
-    SetHandleInformation(hChildStdoutRd, HANDLE_FLAG_INHERIT, 0);
-
-    // 启动服务器进程
-    PROCESS_INFORMATION pi;
-    STARTUPINFO si;
-    ZeroMemory(&si, sizeof(STARTUPINFO));
-    si.cb = sizeof(STARTUPINFO);
-    si.hStdInput = hChildStdinRd;
-    si.hStdOutput = hChildStdoutWr;
-    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
-    si.dwFlags |= STARTF_USESTDHANDLES;
-
-    if (!CreateProcess(
-        NULL,
-        const_cast<LPWSTR>(std::wstring(serverPath.begin(), serverPath.end()).c_str()),
-        NULL,
-        NULL,
-        TRUE,
-        0,
-        NULL,
-        NULL,
-        &si,
-        &pi)) {
-        std::cerr << "Failed to start server process" << std::endl;
-        return false;
+bool LSPClient::connectTransport(std::unique_ptr<Transport> newTransport) {
+    // 外部提供的传输层无法重新建立，断开后不自动重连
+    stopReconnect();
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex);
+        transportFactory = nullptr;
     }
+    closingSession = false;
+    return openSession(std::move(newTransport));
+}
 
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-    CloseHandle(hChildStdinRd);
-    CloseHandle(hChildStdoutWr);
-
-    // 打开文件句柄
-    int inFd = _open_osfhandle((intptr_t)hChildStdoutRd, _O_RDONLY | _O_BINARY);
-    int outFd = _open_osfhandle((intptr_t)hChildStdinWr, _O_WRONLY | _O_BINARY);
-
-    serverIn = _fdopen(inFd, "rb");
-    serverOut = _fdopen(outFd, "wb");
-#else
-    // Linux 实现
-    int stdinPipe[2];  // 用于向子进程写入数据
-    int stdoutPipe[2]; // 用于从子进程读取数据
-
-    if (pipe(stdinPipe) < 0 || pipe(stdoutPipe) < 0) {
-        std::cerr << "Failed to create pipes" << std::endl;
+bool LSPClient::connectWith(TransportFactory factory) {
+    stopReconnect();
+    std::unique_ptr<Transport> newTransport = factory();
+    if (!newTransport) {
         return false;
     }
-
-    pid_t pid = fork();
-    if (pid < 0) {
-        std::cerr << "Failed to fork process" << std::endl;
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex);
+        transportFactory = std::move(factory);
     }
+    closingSession = false;
+    return openSession(std::move(newTransport));
+}
 
-    if (pid == 0) {  // 子进程
-        // 设置标准输入输出
-        dup2(stdinPipe[0], STDIN_FILENO);
-        dup2(stdoutPipe[1], STDOUT_FILENO);
-
-        // 关闭不需要的管道端
-        close(stdinPipe[1]);
-        close(stdoutPipe[0]);
-        close(stdinPipe[0]);
-        close(stdoutPipe[1]);
-
-        // 分解命令行参数
-        execlp("java", "java", "-jar", serverPath.c_str(), "--stdio", NULL);
-        perror("Failed to execute java");
-        exit(1);
+bool LSPClient::openSession(std::unique_ptr<Transport> newTransport, std::chrono::milliseconds handshakeTimeout) {
+    // 替换传输层前关闭旧连接并回收监听线程
+    if (currentTransport()) {
+        closeConnection();
     }
-
-    // 父进程
-    // 关闭不需要的管道端
-    close(stdinPipe[0]);
-    close(stdoutPipe[1]);
-
-    // 打开文件描述符
-    serverOut = fdopen(stdinPipe[1], "w");
-    serverIn = fdopen(stdoutPipe[0], "r");
-#endif
-
-    if (!serverIn || !serverOut) {
-        std::cerr << "Failed to open server pipes" << std::endl;
-        return false;
+    std::shared_ptr<Transport> current(std::move(newTransport));
+    {
+        std::lock_guard<std::mutex> lock(transportMutex);
+        transport = current;
+    }
+    {
+        std::lock_guard<std::mutex> lock(readMutex);
+        reader.reset(current.get());
     }
+    outbound.reset(current.get());
+    responseCache.clear();
 
     // 打开一个Java文件进行分析
     std::string filePath = "/mnt/d/Course/Year4/QLextension/DemoProject-master/src/main/java/tutorial1/Main.java";
@@ -149,13 +98,22 @@ bool LSPClient::initialize(const std::string& serverPath) {
         {"workspaceFolders", json::array({
             {{"uri", rootUri}, {"name", "DemoProject"}}
         })},
+        {"initializationOptions", json::object()},
         {"capabilities", {
+            // 优先使用 UTF-8 列号，服务器支持时无需转换
+            {"general", {
+                {"positionEncodings", json::array({"utf-8", "utf-16"})}
+            }},
             {"workspace", {
                 {"configuration", true},
                 {"workspaceFolders", true},
                 // 修改这里：didChangeConfiguration应该是一个对象，而不是简单值
                 {"didChangeConfiguration", {
                     {"dynamicRegistration", true}
+                }},
+                // 工作区文件变化由客户端自行监视后通知
+                {"didChangeWatchedFiles", {
+                    {"dynamicRegistration", false}
                 }}
             }},
             {"textDocument", {
@@ -168,103 +126,582 @@ bool LSPClient::initialize(const std::string& serverPath) {
         }},
     };
 
+    {
+        // 服务器可以据此判断上次的分析结果是否仍然可用
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!workspaceState.empty()) {
+            initParams["initializationOptions"]["workspaceState"] = workspaceState;
+        }
+        // 服务器之后查询工作区文件夹时返回同一份列表
+        workspaceFolders = initParams["workspaceFolders"];
+    }
+
+    // 先启动消息监听器，握手阶段的响应也由它按 id 送回
+    startMessageListener();
+
     // 发送初始化请求并等待响应
-    json response = sendRequest("initialize", initParams);
+    setState(SessionState::Initializing);
+    // 直接走异步路径，重新连接期间 sendRequest 会等待会话恢复
+    json response = sendRequestAsync("initialize", initParams, handshakeTimeout).get();
     
     // 检查响应是否有效
     if (response.empty() || (response.contains("error") && !response["error"].is_null())) {
         std::cerr << "初始化失败: " << response.dump(2) << std::endl;
+        setState(SessionState::Disconnected);
         return false;
     }
-    
-    // 等待一小段时间再发送initialized通知
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    
-    // 发送initialized通知
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        serverCapabilities = response["result"].value("capabilities", json::object());
+
+        // textDocumentSync 可以是数字或对象；完全没有声明时按全量同步
+        auto syncIt = serverCapabilities.find("textDocumentSync");
+        int kind = kSyncFull;
+        if (syncIt != serverCapabilities.end()) {
+            if (syncIt->is_number_integer()) {
+                kind = syncIt->get<int>();
+            } else if (syncIt->is_object()) {
+                kind = syncIt->value("change", kSyncNone);
+            }
+        }
+        textSyncKind = kind;
+
+        PositionEncoding encoding = PositionEncoding::Utf16;
+        auto encodingIt = serverCapabilities.find("positionEncoding");
+        if (encodingIt != serverCapabilities.end() && encodingIt->is_string() &&
+            !PositionCodec::parse(encodingIt->get<std::string>(), encoding)) {
+            std::cerr << "服务器选择了未声明的位置编码: " << encodingIt->dump() << std::endl;
+        }
+        positionEncoding = encoding;
+    }
+
+    // 收到响应即可发送 initialized，之后的消息在同一连接上按序到达服务器，无需等待
     sendNotification("initialized", json::object());
-        
-    // 启动消息监听器
-    startMessageListener();
 
-    return true;
+    // 重新推送已保存的配置
+    json settings;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        settings = configuration;
+    }
+    if (!settings.empty()) {
+        sendNotification("workspace/didChangeConfiguration", {{"settings", settings}});
+    }
+
+    replayDocuments();
+
+    // 握手期间连接可能已经断开，这时 setState 不会覆盖断开处理设置的状态
+    setState(SessionState::Ready);
+    return isRunning;
+}
+
+void LSPClient::replayDocuments() {
+    // 新连接上的服务器不知道排队中的变更，重新打开时已经带上最新内容
+    {
+        std::lock_guard<std::mutex> lock(changeMutex);
+        for (auto& entry : pendingChanges) {
+            loop.cancelTimer(entry.second.timerId);
+        }
+        pendingChanges.clear();
+        syncedDocuments.clear();
+    }
+
+    for (const auto& [uri, document] : documents.all()) {
+        sendDidOpen(uri, *document);
+        responseCache.setVersion(uri, document->getVersion());
+        if (textSyncKind == kSyncIncremental) {
+            std::lock_guard<std::mutex> lock(changeMutex);
+            syncedDocuments[uri] = document;
+        }
+    }
+}
+
+void LSPClient::sendDidOpen(const std::string& uri, const Document& document) {
+    outbound.send(didOpenBody(uri, document), priorityOf("textDocument/didOpen"), uri);
+}
+
+std::string LSPClient::didOpenBody(const std::string& uri, const Document& document) {
+    // 转义最多让文本变长少许，预留余量后通常只分配一次
+    std::string body;
+    body.reserve(document.size() + document.size() / 16 + uri.size() + 160);
+    body.append(R"({"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":)");
+    JsonEscape::appendQuoted(body, uri);
+    body.append(R"(,"languageId":)");
+    JsonEscape::appendQuoted(body, document.getLanguageId());
+    body.append(R"(,"version":)");
+    body.append(std::to_string(document.getVersion()));
+    body.append(R"(,"text":")");
+    // 片段边界可能截断多字节字符，由 Stream 拼接后再校验
+    JsonEscape::Stream text(body);
+    document.forEachChunk([&text](std::string_view chunk) { text.append(chunk); });
+    text.finish();
+    body.append(R"("}}})");
+    return body;
+}
+
+void LSPClient::onConnectionLost(const char* reason) {
+    if (closingSession) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(reconnectMutex);
+    if (reconnecting) {
+        return;
+    }
+    if (!transportFactory) {
+        // 外部提供的传输层无法重新建立，连接断开即会话结束
+        std::cerr << "连接中断（" << reason << "）" << std::endl;
+        setState(SessionState::Disconnected);
+        return;
+    }
+    if (reconnectThread.joinable()) {
+        // 上一次重连已经结束
+        reconnectThread.join();
+    }
+    reconnecting = true;
+    std::cerr << "连接中断（" << reason << "），开始重新连接" << std::endl;
+    setState(SessionState::Reconnecting);
+    reconnectThread = std::thread([this]() { reconnectLoop(); });
+}
+
+void LSPClient::reconnectLoop() {
+    // 旧连接可能半开，不再等待排队的消息写出
+    closeConnection(false);
+    setState(SessionState::Reconnecting);
+
+    auto start = std::chrono::steady_clock::now();
+    auto delay = kReconnectInitialDelay;
+    int attempts = 0;
+    bool connected = false;
+    while (!closingSession) {
+        if (attempts == kReconnectMaxAttempts) {
+            std::cerr << "重新连接失败 " << attempts << " 次，放弃重连" << std::endl;
+            break;
+        }
+        ++attempts;
+        TransportFactory factory;
+        {
+            std::lock_guard<std::mutex> lock(reconnectMutex);
+            factory = transportFactory;
+        }
+        std::unique_ptr<Transport> newTransport = factory ? factory() : nullptr;
+        if (newTransport && openSession(std::move(newTransport), kReconnectHandshakeTimeout)) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            std::cout << "已重新连接，尝试 " << attempts << " 次，耗时 " << elapsed << " ms" << std::endl;
+            if (heartbeatEnabled) {
+                startHeartbeat();
+            }
+            connected = true;
+            break;
+        }
+        setState(SessionState::Reconnecting);
+
+        // 指数退避，关闭时立即结束等待
+        std::unique_lock<std::mutex> lock(stateMutex);
+        stateChanged.wait_for(lock, delay, [this]() { return closingSession.load(); });
+        delay = std::min(delay * 2, kReconnectMaxDelay);
+    }
+
+    if (!connected) {
+        setState(SessionState::Disconnected);
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        reconnecting = false;
+    }
+    stateChanged.notify_all();
+}
+
+void LSPClient::stopReconnect() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        closingSession = true;
+    }
+    stateChanged.notify_all();
+
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex);
+        thread = std::move(reconnectThread);
+    }
+    if (thread.joinable()) {
+        if (thread.get_id() == std::this_thread::get_id()) {
+            // 在重连线程的回调中关闭，线程随后自行结束
+            thread.detach();
+        } else {
+            thread.join();
+        }
+    }
+}
+
+void LSPClient::waitForReconnect(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    stateChanged.wait_for(lock, timeout, [this]() { return !reconnecting || closingSession; });
+}
+
+void LSPClient::setState(SessionState state) {
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        // 监听线程已因连接断开停止时不能再进入 Ready；断开处理先清除 isRunning 再设置状态
+        if (state == SessionState::Ready && !isRunning) {
+            return;
+        }
+        sessionState = state;
+        if (state == SessionState::Ready) {
+            callbacks.swap(readyCallbacks);
+        }
+    }
+    stateChanged.notify_all();
+    for (auto& callback : callbacks) {
+        callback();
+    }
 }
 
-json LSPClient::sendRequest(const std::string& method, const json& params) {
+SessionState LSPClient::getState() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return sessionState;
+}
+
+bool LSPClient::waitUntilReady(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    return stateChanged.wait_for(lock, timeout, [this]() {
+        return sessionState == SessionState::Ready;
+    });
+}
+
+void LSPClient::onReady(std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (sessionState != SessionState::Ready) {
+            readyCallbacks.push_back(std::move(callback));
+            return;
+        }
+    }
+    callback();
+}
+
+json LSPClient::getServerCapabilities() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return serverCapabilities;
+}
+
+void LSPClient::setWorkspaceState(const std::string& state) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    workspaceState = state;
+}
+
+bool LSPClient::serverHasWorkspaceState() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (workspaceState.empty()) {
+        return false;
+    }
+    auto experimental = serverCapabilities.find("experimental");
+    return experimental != serverCapabilities.end() && experimental->is_object() &&
+           experimental->value("workspaceState", std::string()) == workspaceState;
+}
+
+PositionEncoding LSPClient::getPositionEncoding() const {
+    return positionEncoding.load();
+}
+
+void LSPClient::changeConfiguration(const json& settings) {
+    {
+        // 按顶层配置节合并保存，供 workspace/configuration 查询和重新连接时推送
+        // 不是对象的配置无法按节合并，整体替换保存，原样发给服务器
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!settings.is_object()) {
+            configuration = settings;
+        } else {
+            if (!configuration.is_object()) {
+                configuration = json::object();
+            }
+            for (auto it = settings.begin(); it != settings.end(); ++it) {
+                configuration[it.key()] = it.value();
+            }
+        }
+    }
+    sendNotification("workspace/didChangeConfiguration", {{"settings", settings}});
+}
+
+json LSPClient::sendRequest(const std::string& method, const json& params, std::chrono::milliseconds timeout) {
+    // 正在重新连接时先等待会话恢复，而不是立即返回空对象
+    if (reconnecting) {
+        long long defaultMs = requestTimeoutMs.load(std::memory_order_relaxed);
+        waitForReconnect(timeout.count() >= 0 ? timeout
+                         : std::chrono::milliseconds(defaultMs > 0 ? defaultMs : 60000));
+    }
+
+    // 监听线程运行时由它按 id 送回响应
+    if (isRunning) {
+        return sendRequestAsync(method, params, timeout).get();
+    }
+
+    // 否则在当前线程读取，直到收到对应的响应，期间的其他消息照常处理
+    int id = nextRequestId();
+    if (!writeRequest(id, method, params)) {
+        return json::object();
+    }
+    while (true) {
+        json message = readResponse();
+        if (message.empty()) {
+            return message;
+        }
+        if (!message.contains("method") && message.contains("id") && message["id"] == id) {
+            return message;
+        }
+        handleMessage(std::move(message));
+    }
+}
+
+std::future<json> LSPClient::sendRequestAsync(const std::string& method, const json& params, std::chrono::milliseconds timeout) {
+    auto promise = std::make_shared<std::promise<json>>();
+    std::future<json> future = promise->get_future();
+    sendRequestAsync(method, params, [promise](const json& response) {
+        promise->set_value(response);
+    }, timeout);
+    return future;
+}
+
+int LSPClient::sendRequestAsync(const std::string& method, const json& params, ResponseCallback callback,
+                                std::chrono::milliseconds timeout) {
+    if (timeout == kDefaultTimeout) {
+        timeout = std::chrono::milliseconds(requestTimeoutMs.load());
+    }
+
+    int id = nextRequestId();
+    // 规范不允许取消 initialize 和 shutdown，超时只在本地结束等待
+    bool cancellable = method != "initialize" && method != "shutdown";
+
+    // 先登记再发送，避免响应比登记更早到达
+    uint64_t timerId = 0;
+    if (timeout.count() > 0) {
+        std::lock_guard<std::mutex> lock(deadlineMutex);
+        timerId = deadlines.schedule(timeout, [this, id, cancellable]() {
+            expireRequest(id, cancellable);
+        });
+        armDeadlineTimer();
+    }
+    if (!pendingCalls.add(id, std::move(callback), timerId, isRunning)) {
+        std::cerr << "监听线程未运行，无法发送异步请求: " << method << std::endl;
+        cancelDeadline(timerId);
+        callback(json::object());
+        return -1;
+    }
+
+    if (!writeRequest(id, method, params)) {
+        ResponseCallback pending = takePendingRequest(id);
+        if (pending) {
+            pending(json::object());
+        }
+    }
+    return id;
+}
+
+bool LSPClient::cancelRequest(int id) {
+    return abandonRequest(id, "Request cancelled");
+}
+
+void LSPClient::setRequestTimeout(std::chrono::milliseconds timeout) {
+    requestTimeoutMs = timeout.count() > 0 ? timeout.count() : 0;
+}
+
+MessagePriority LSPClient::priorityOf(const std::string& method) {
+    // 用户正在等待结果的请求
+    static constexpr std::string_view kInteractive[] = {
+        "textDocument/completion",
+        "textDocument/definition",
+        "textDocument/hover",
+        "textDocument/signatureHelp",
+        "$/cancelRequest"
+    };
+    for (std::string_view name : kInteractive) {
+        if (method == name) {
+            return MessagePriority::Interactive;
+        }
+    }
+    if (method == "textDocument/didOpen") {
+        return MessagePriority::Bulk;
+    }
+    return MessagePriority::Normal;
+}
+
+std::string LSPClient::documentKey(const json& params) {
+    if (!params.is_object()) {
+        return std::string();
+    }
+    auto documentIt = params.find("textDocument");
+    const json& owner = documentIt != params.end() && documentIt->is_object() ? *documentIt : params;
+    auto uriIt = owner.find("uri");
+    if (uriIt == owner.end() || !uriIt->is_string()) {
+        return std::string();
+    }
+    return uriIt->get<std::string>();
+}
+
+int LSPClient::nextRequestId() {
+    return requestId.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool LSPClient::writeRequest(int id, const std::string& method, const json& params) {
+    // 请求依赖的文档变更必须先于请求发出，不针对单个文档的请求发出全部变更
+    std::string key = documentKey(params);
+    flushDocumentChanges(key);
+
     json request = {
         {"jsonrpc", "2.0"},
-        {"id", requestId++},
+        {"id", id},
         {"method", method},
         {"params", params}
     };
 
+    // 序列化在调用线程完成，调度器只负责排队和写出
     std::string content = request.dump();
-    std::string message = "Content-Length: " + std::to_string(content.length()) + "\r\n\r\n" + content;
-    
-    fwrite(message.c_str(), 1, message.length(), serverOut);
-    fflush(serverOut);
-    
-    // 读取服务器响应
-    json response = readResponse();
-    
-    // 如果是不支持的方法，尝试从通知中获取信息
-    if (method == "source" && response.empty()) {
-        // 再次读取一次，可能有通知消息
-        response = readResponse();
+    // 等待响应前必须把暂存的消息一并发出
+    outbound.release();
+    return outbound.send(std::move(content), priorityOf(method), std::move(key), id);
+}
+
+bool LSPClient::completeRequest(const json& message) {
+    // 只处理客户端发出的请求的响应，服务器发来的请求带有 method
+    if (message.contains("method") || !message.contains("id") || !message["id"].is_number_integer()) {
+        return false;
     }
-    
-    return response;
+
+    ResponseCallback callback;
+    uint64_t timerId = 0;
+    switch (pendingCalls.takeForResponse(message["id"].get<int>(), callback, timerId)) {
+    case PendingCalls::Lookup::Missing:
+        return false;
+    case PendingCalls::Lookup::Abandoned:
+        // 已超时或取消的请求，迟到的响应直接丢弃
+        return true;
+    case PendingCalls::Lookup::Found:
+        break;
+    }
+    cancelDeadline(timerId);
+    callback(message);
+    return true;
 }
 
-json LSPClient::readResponse() {
-    char header[1024];
-    int contentLength = -1;
-    bool headerEnd = false;
+LSPClient::ResponseCallback LSPClient::takePendingRequest(int id) {
+    ResponseCallback callback;
+    uint64_t timerId = 0;
+    if (!pendingCalls.take(id, callback, timerId)) {
+        return nullptr;
+    }
+    cancelDeadline(timerId);
+    return callback;
+}
 
-    // 清空缓冲区
-    memset(header, 0, sizeof(header));
+bool LSPClient::abandonRequest(int id, const char* reason, bool notifyServer) {
+    ResponseCallback callback;
+    uint64_t timerId = 0;
+    if (!pendingCalls.abandon(id, callback, timerId)) {
+        return false;
+    }
+    cancelDeadline(timerId);
 
-    // 读取头部，查找 Content-Length
-    while (fgets(header, sizeof(header), serverIn)) {
-        if (strlen(header) == 0) {
-            continue; // 跳过空行
-        }
+    // 通知服务器放弃处理，调用方收到 RequestCancelled 错误。
+    // 请求还在低优先级队列中时直接撤回，否则取消通知会先于请求到达服务器
+    if (notifyServer && !outbound.withdraw(id)) {
+        sendNotification("$/cancelRequest", {{"id", id}});
+    }
+    callback({
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"error", {
+            {"code", kRequestCancelled},
+            {"message", reason}
+        }}
+    });
+    return true;
+}
 
-        if (strncmp(header, "Content-Length: ", 16) == 0) {
-            contentLength = atoi(header + 16);
-        } else if (strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0) {
-            headerEnd = true;
-            break;
-        }
-        
-        memset(header, 0, sizeof(header)); // 清空缓冲区
+void LSPClient::expireRequest(int id, bool cancellable) {
+    if (abandonRequest(id, "Request timed out", cancellable)) {
+        std::cerr << "请求超时已取消，ID: " << id << std::endl;
     }
+}
 
-    if (!headerEnd || contentLength <= 0) {
-        if (isRunning) {
-            std::cerr << "无效的响应头或未找到Content-Length" << std::endl;
+void LSPClient::cancelDeadline(uint64_t timerId) {
+    if (timerId != 0) {
+        std::lock_guard<std::mutex> lock(deadlineMutex);
+        deadlines.cancel(timerId);
+    }
+}
+
+void LSPClient::armDeadlineTimer() {
+    // 调用方持有 deadlineMutex；时间轮非空时才让事件循环按 tick 推进
+    if (deadlineTimerId != 0 || deadlines.empty()) {
+        return;
+    }
+    deadlineTimerId = loop.addTimer(deadlines.getTick(), [this]() {
+        onDeadlineTick();
+    });
+}
+
+void LSPClient::onDeadlineTick() {
+    std::vector<TimerWheel::Callback> expired;
+    {
+        std::lock_guard<std::mutex> lock(deadlineMutex);
+        deadlineTimerId = 0;
+        expired = deadlines.advance();
+        armDeadlineTimer();
+    }
+    // 取消通知的写出和调用方的回调都不在事件循环线程上执行
+    for (auto& callback : expired) {
+        handlerPool.submit("$/cancelRequest", std::move(callback));
+    }
+}
+
+void LSPClient::failPendingRequests() {
+    // 先拒绝新的登记，再取出已登记的请求
+    isRunning = false;
+    std::vector<ResponseCallback> pending = pendingCalls.takeAll();
+    {
+        // 撤销推进时间轮的定时器，否则重新连接后会同时存在两个
+        std::lock_guard<std::mutex> lock(deadlineMutex);
+        deadlines.clear();
+        if (deadlineTimerId != 0) {
+            loop.cancelTimer(deadlineTimerId);
+            deadlineTimerId = 0;
         }
-        return json::object();
     }
+    for (auto& callback : pending) {
+        callback(json::object());
+    }
+}
 
-    // 读取消息内容
-    std::vector<char> buffer(contentLength + 1);
-    size_t bytesRead = fread(buffer.data(), 1, contentLength, serverIn);
-    
-    if (bytesRead != contentLength) {
+json LSPClient::readResponse() {
+    const char* body = nullptr;
+    size_t contentLength = 0;
+    std::lock_guard<std::mutex> lock(readMutex);
+
+    // 从缓冲区取出下一帧，必要时批量读取
+    FrameReader::Status status = reader.readFrame(body, contentLength);
+    if (status != FrameReader::Status::Frame) {
         if (isRunning) {
-            std::cerr << "读取数据不完整: " << bytesRead << "/" << contentLength << std::endl;
+            if (status == FrameReader::Status::Eof) {
+                std::cerr << "服务器连接已关闭" << std::endl;
+            } else {
+                std::cerr << "无效的响应头或未找到Content-Length" << std::endl;
+            }
         }
         return json::object();
     }
-    
-    buffer[bytesRead] = '\0';
-    
+
+    return parseFrame(body, contentLength);
+}
+
+json LSPClient::parseFrame(const char* body, size_t length) {
+    // 直接在缓冲区上解析消息体
     try {
-        return json::parse(buffer.data());
+        return json::parse(body, body + length);
     } catch (const std::exception& e) {
         if (isRunning) {
             std::cerr << "解析响应失败: " << e.what() << std::endl;
-            std::cerr << "原始数据: " << buffer.data() << std::endl;
+            std::cerr << "原始数据: " << std::string(body, length) << std::endl;
         }
         return json::object();
     }
@@ -278,135 +715,406 @@ void LSPClient::sendNotification(const std::string& method, const json& params)
     };
 
     std::string content = notification.dump();
-    std::string message = "Content-Length: " + std::to_string(content.length()) + "\r\n\r\n" + content;
-    
-    fwrite(message.c_str(), 1, message.length(), serverOut);
-    fflush(serverOut);
+    outbound.send(std::move(content), priorityOf(method), documentKey(params));
+}
+
+void LSPClient::beginBatch() {
+    outbound.hold();
+}
+
+bool LSPClient::endBatch() {
+    return outbound.release() && outbound.drain();
 }
 
-void LSPClient::openDocument(const std::string& uri, const std::string& text, const std::string& languageId) {
+void LSPClient::openDocument(const std::string& uri, std::string_view text, const std::string& languageId) {
     // 确保 URI 格式正确
     std::string normalizedUri = uri;
     if (normalizedUri.find("file:///") != 0) {
         normalizedUri = "file:///" + normalizedUri;
     }
     
-    json params = {
-        {"textDocument", {
-            {"uri", normalizedUri},
-            {"languageId", languageId},
-            {"version", 1},
-            {"text", text}
-        }}
-    };
-    
-    sendNotification("textDocument/didOpen", params);
+    // 片段表和消息体在锁外构建，多个加载线程可以并行打开文档
+    DocumentSnapshot document = Document::create(languageId, text, 1);
+    std::string body = didOpenBody(normalizedUri, *document);
+    {
+        // 安装快照和发出 didOpen 同在 syncMutex 下完成，之后取出的 didChange 不会排在 didOpen 之前
+        std::lock_guard<std::mutex> syncLock(syncMutex);
+        {
+            // 增量同步以服务器上的内容为基准计算差异
+            std::lock_guard<std::mutex> lock(changeMutex);
+            documents.open(normalizedUri, document);
+            auto pending = pendingChanges.find(normalizedUri);
+            if (pending != pendingChanges.end()) {
+                loop.cancelTimer(pending->second.timerId);
+                pendingChanges.erase(pending);
+            }
+            if (textSyncKind == kSyncIncremental) {
+                syncedDocuments[normalizedUri] = document;
+            } else {
+                syncedDocuments.erase(normalizedUri);
+            }
+        }
+        outbound.send(std::move(body), priorityOf("textDocument/didOpen"), normalizedUri);
+    }
+    responseCache.setVersion(normalizedUri, 1);
 }
 
-std::vector<json> LSPClient::getDiagnostics(const std::string& uri) {
-    // 实际应用中，诊断信息通常是通过服务器推送的
-    // 这里简化处理，返回存储的诊断信息
-    if (diagnostics.find(uri) != diagnostics.end()) {
-        return diagnostics[uri];
-    }
-    return {};
+DiagnosticsSnapshot LSPClient::getDiagnostics(const std::string& uri) {
+    // 诊断信息由服务器推送，这里返回最近一次推送的不可变快照
+    return diagnostics.get(uri);
 }
 
 void LSPClient::shutdown() {
-    if (serverIn && serverOut) {
-        // 先停止监听线程
-        isRunning = false;
-        
-        // 给线程一点时间退出
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
-        
-        // // 发送shutdown请求 这是告知服务器Client已经退出
-        // sendRequest("shutdown", json::object());
-        json response = sendRequest("shutdown", json::object());
+    stopReconnect();
+    // 监听线程仍在运行时按 id 等待 shutdown 响应，超过截止时间不再等待
+    std::shared_ptr<Transport> current = currentTransport();
+    if (current && current->isOpen() && isRunning) {
+        json response = sendRequest("shutdown", json::object(), kShutdownTimeout);
         std::cout << "服务器响应shutdown请求: " << response.dump(2) << std::endl;
-        
-        // 发送exit通知 这是告知Server退出的指令
-        // sendNotification("exit", json::object());
-        
-        // 再次确认监听线程已退出
-        std::cout << "等待监听线程退出..." << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(300));
-
-        // 获取文件描述符以便正确关闭
-        int inFd = fileno(serverIn);
-        int outFd = fileno(serverOut);
-        
-        // 关闭文件流
-        fclose(serverIn);
-        fclose(serverOut);
-        serverIn = nullptr;
-        serverOut = nullptr;
-        close(inFd);
-        close(outFd);
+    }
+    closeConnection();
+}
+
+std::shared_ptr<Transport> LSPClient::currentTransport() {
+    std::lock_guard<std::mutex> lock(transportMutex);
+    return transport;
+}
+
+void LSPClient::closeConnection(bool drain) {
+    std::shared_ptr<Transport> current = currentTransport();
+    if (drain && current && current->isOpen()) {
+        // 关闭传输层前把排队的消息写完，服务器不再读取时不无限等待
+        outbound.drain(kShutdownTimeout);
+    }
+
+    // 先停止并回收监听线程，之后再关闭 fd，避免监听线程读到已关闭或被复用的 fd
+    stopMessageListener();
+
+    if (current && current->isOpen()) {
+        current->close();
         std::cout << "LSP客户端已关闭" << std::endl;
     }
+    // 写线程可能仍阻塞在旧连接上，等它退出后解除绑定，之后的发送直接失败
+    outbound.reset(nullptr);
+    failPendingRequests();
+    setState(SessionState::Disconnected);
+}
+
+void LSPClient::stopMessageListener() {
+    isRunning = false;
+    if (std::shared_ptr<Transport> current = currentTransport()) {
+        loop.removeFd(current->readFd());
+    }
+    if (listenerThread.joinable()) {
+        // 通过 eventfd 立即唤醒阻塞在 epoll_wait 上的监听线程
+        loop.stop();
+        if (listenerThread.get_id() == std::this_thread::get_id()) {
+            // 在监听线程的回调中关闭，线程在回调返回后自行退出，之后再回收
+            return;
+        }
+        listenerThread.join();
+    }
 }
 void LSPClient::exitServer() {
-    if (serverIn && serverOut) {
-        // 先停止监听线程
-        isRunning = false;
-        
-        // 发送shutdown请求
-        json response = sendRequest("shutdown", json::object());
+    stopReconnect();
+    std::shared_ptr<Transport> current = currentTransport();
+    if (current && current->isOpen() && isRunning) {
+        // 按 id 等待 shutdown 响应，随后通知服务器退出
+        json response = sendRequest("shutdown", json::object(), kShutdownTimeout);
         std::cout << "服务器响应shutdown请求: " << response.dump(2) << std::endl;
-        
-        // 等待服务器处理
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        
-        // 发送exit通知
         sendNotification("exit", json::object());
-        
-        // 等待更长时间确保服务器处理完成
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        
-        // 关闭连接
-        shutdown();
     }
+    closeConnection();
 }
 
 
 
 void LSPClient::documentDidChange(const std::string& uri, const std::string& newContent, int version) {
+    responseCache.setVersion(uri, version);
+    bool immediate;
+    {
+        std::lock_guard<std::mutex> lock(changeMutex);
+        // 记录最新内容，重新连接时按当前版本重新打开；未打开的文档只用于本次发送
+        DocumentSnapshot document = documents.replace(uri, newContent, version);
+        if (!document) {
+            document = Document::create(std::string(), newContent, version);
+        }
+        PendingChange& change = pendingChanges[uri];
+        change.document = std::move(document);
+        change.edits = json::array();
+        change.fullText = true;
+        immediate = scheduleDidChange(uri);
+    }
+    if (immediate) {
+        flushDocumentChanges(uri);
+    }
+}
+
+int LSPClient::applyEdit(const std::string& uri, const TextRange& range, const std::string& text) {
+    DocumentSnapshot document;
+    bool immediate;
+    {
+        std::lock_guard<std::mutex> lock(changeMutex);
+        document = documents.applyEdit(uri, range, text, positionEncoding.load());
+        if (!document) {
+            std::cerr << "编辑失败，文档未打开或范围无效: " << uri << std::endl;
+            return -1;
+        }
+        responseCache.setVersion(uri, document->getVersion());
+
+        // 编辑按发生顺序排队，服务器依次应用后得到相同的内容
+        PendingChange& change = pendingChanges[uri];
+        change.document = document;
+        if (!change.fullText) {
+            change.edits.push_back({
+                {"range", {
+                    {"start", {{"line", range.start.line}, {"character", range.start.character}}},
+                    {"end", {{"line", range.end.line}, {"character", range.end.character}}}
+                }},
+                {"text", text}
+            });
+        }
+        immediate = scheduleDidChange(uri);
+    }
+    if (immediate) {
+        flushDocumentChanges(uri);
+    }
+    return document->getVersion();
+}
+
+DocumentSnapshot LSPClient::getDocument(const std::string& uri) {
+    return documents.get(uri);
+}
+
+void LSPClient::closeDocument(const std::string& uri) {
+    {
+        std::lock_guard<std::mutex> lock(changeMutex);
+        auto pending = pendingChanges.find(uri);
+        if (pending != pendingChanges.end()) {
+            loop.cancelTimer(pending->second.timerId);
+            pendingChanges.erase(pending);
+        }
+        syncedDocuments.erase(uri);
+        if (!documents.close(uri)) {
+            return;
+        }
+    }
+    responseCache.close(uri);
+    sendNotification("textDocument/didClose", {
+        {"textDocument", {{"uri", uri}}}
+    });
+}
+
+bool LSPClient::watchWorkspace(const std::vector<std::string>& roots, const std::vector<std::string>& extensions) {
+    return watcher.start(roots, extensions, [this](std::vector<FileChange> changes) {
+        // 读文件和发送不占用监听线程，同一个 key 保证批次按顺序处理
+        handlerPool.submit("workspace/watch", [this, changes = std::move(changes)]() {
+            onWorkspaceChanges(changes);
+        });
+    });
+}
+
+void LSPClient::stopWatchingWorkspace() {
+    watcher.stop();
+}
+
+void LSPClient::onWorkspaceChanges(const std::vector<FileChange>& changes) {
+    json events = json::array();
+    for (const FileChange& change : changes) {
+        std::string uri = FileUtils::pathToUri(change.path);
+        DocumentSnapshot document = documents.get(uri);
+        if (!document || change.type == FileChangeType::Deleted) {
+            events.push_back({{"uri", uri}, {"type", static_cast<int>(change.type)}});
+            continue;
+        }
+
+        // 已打开的文档：内容与客户端一致时只是保存，否则先同步内容
+        FileView file;
+        if (!file.open(change.path)) {
+            // 多半是事件之后文件又被删除或移走，删除会在下一批上报；不能当作空文件覆盖文档
+            std::cerr << "无法读取变化的文件: " << change.path << std::endl;
+            continue;
+        }
+        if (file.view() != document->text()) {
+            documentDidChange(uri, std::string(file.view()), document->getVersion() + 1);
+        }
+        documentDidSave(uri);
+    }
+    if (!events.empty()) {
+        sendNotification("workspace/didChangeWatchedFiles", {{"changes", std::move(events)}});
+    }
+}
+
+bool LSPClient::scheduleDidChange(const std::string& uri) {
+    PendingChange& change = pendingChanges[uri];
+    long long debounceMs = changeDebounceMs.load(std::memory_order_relaxed);
+    // 没有监听线程时定时器不会触发，直接发送
+    if (debounceMs <= 0 || !isRunning) {
+        return true;
+    }
+
+    // 窗口内的变更合并发送，窗口从第一次变更开始计时，持续输入时也会按时发出
+    if (change.timerId == 0) {
+        change.timerId = loop.addTimer(std::chrono::milliseconds(debounceMs), [this, uri]() {
+            onChangeDebounce(uri);
+        });
+    }
+    return false;
+}
+
+void LSPClient::setChangeDebounce(std::chrono::milliseconds window) {
+    changeDebounceMs = window.count();
+    if (window.count() <= 0) {
+        flushDocumentChanges();
+    }
+}
+
+void LSPClient::flushDocumentChanges(const std::string& uri) {
+    // 差异计算和写出不持有 changeMutex，编辑不会被大文档的比较或阻塞的写入卡住；
+    // syncMutex 保证同一文档的 didChange 按取出的顺序发出
+    std::lock_guard<std::mutex> syncLock(syncMutex);
+    std::vector<OutgoingChange> outgoing;
+    {
+        std::lock_guard<std::mutex> lock(changeMutex);
+        if (pendingChanges.empty()) {
+            return;
+        }
+        if (!uri.empty()) {
+            auto it = pendingChanges.find(uri);
+            if (it == pendingChanges.end()) {
+                return;
+            }
+            takeChange(it->first, it->second, outgoing);
+            pendingChanges.erase(it);
+        } else {
+            for (auto& entry : pendingChanges) {
+                takeChange(entry.first, entry.second, outgoing);
+            }
+            pendingChanges.clear();
+        }
+    }
+    for (const OutgoingChange& change : outgoing) {
+        sendDidChange(change);
+    }
+}
+
+void LSPClient::onChangeDebounce(const std::string& uri) {
+    // 事件循环线程只负责收发分派，同一文档的发送按 URI 在处理线程池中串行
+    handlerPool.submit(uri, [this, uri]() {
+        flushDocumentChanges(uri);
+    });
+}
+
+void LSPClient::takeChange(const std::string& uri, PendingChange& change, std::vector<OutgoingChange>& outgoing) {
+    loop.cancelTimer(change.timerId);
+    int kind = textSyncKind.load(std::memory_order_relaxed);
+    if (kind == kSyncNone) {
+        return;
+    }
+
+    OutgoingChange next{uri, change.document, nullptr, json()};
+    auto synced = syncedDocuments.find(uri);
+    if (kind == kSyncIncremental && synced != syncedDocuments.end() && !change.fullText) {
+        // 只经过 applyEdit 的变更直接发送编辑本身
+        if (change.edits.empty()) {
+            return;
+        }
+        next.edits = std::move(change.edits);
+    } else if (kind == kSyncIncremental && synced != syncedDocuments.end()) {
+        next.baseline = synced->second;
+    }
+    if (kind == kSyncIncremental) {
+        syncedDocuments[uri] = change.document;
+    }
+    outgoing.push_back(std::move(next));
+}
+
+void LSPClient::sendDidChange(const OutgoingChange& change) {
+    json contentChanges;
+    if (change.edits.is_array()) {
+        contentChanges = change.edits;
+    } else if (change.baseline) {
+        std::string previous = change.baseline->text();
+        std::string text = change.document->text();
+        std::vector<TextEdit> edits = TextDiff::diff(previous, text);
+        if (edits.empty()) {
+            return;
+        }
+
+        // 位置按旧快照和协商的编码计算
+        PositionEncoding encoding = positionEncoding.load();
+        std::vector<TextPosition> positions;
+        positions.reserve(edits.size() * 2);
+        for (const TextEdit& edit : edits) {
+            positions.push_back(change.baseline->positionAt(edit.start, encoding));
+            positions.push_back(change.baseline->positionAt(edit.end, encoding));
+        }
+
+        // 从后往前发送，前面编辑的位置不受后面编辑的影响，都可以按旧文本计算
+        contentChanges = json::array();
+        for (size_t i = edits.size(); i-- > 0;) {
+            const TextPosition& start = positions[2 * i];
+            const TextPosition& end = positions[2 * i + 1];
+            contentChanges.push_back({
+                {"range", {
+                    {"start", {{"line", start.line}, {"character", start.character}}},
+                    {"end", {{"line", end.line}, {"character", end.character}}}
+                }},
+                {"text", edits[i].text}
+            });
+        }
+    } else {
+        contentChanges = {{{"text", change.document->text()}}};
+    }
+
     json params = {
         {"textDocument", {
-            {"uri", uri},
-            {"version", version}
+            {"uri", change.uri},
+            {"version", change.document->getVersion()}
         }},
-        {"contentChanges", {{
-            {"text", newContent}
-        }}}
+        {"contentChanges", std::move(contentChanges)}
     };
     sendNotification("textDocument/didChange", params);
 }
 
-json LSPClient::requestCompletion(const std::string& uri, int line, int character) {
-    json params = {
+json LSPClient::positionParams(const std::string& uri, int line, int character) {
+    return {
         {"textDocument", {{"uri", uri}}},
         {"position", {
             {"line", line},
             {"character", character}
         }}
     };
-    return sendRequest("textDocument/completion", params);
+}
+
+json LSPClient::requestCompletion(const std::string& uri, int line, int character) {
+    return cachedRequest("textDocument/completion", uri, line, character);
 }
 
 json LSPClient::requestDefinition(const std::string& uri, int line, int character) {
-    json params = {
-        {"textDocument", {{"uri", uri}}},
-        {"position", {
-            {"line", line},
-            {"character", character}
-        }}
-    };
-    return sendRequest("textDocument/definition", params);
+    return cachedRequest("textDocument/definition", uri, line, character);
+}
+
+json LSPClient::cachedRequest(const std::string& method, const std::string& uri, int line, int character) {
+    ResponseCache::Lookup lookup = responseCache.acquire(method, uri, line, character);
+    if (lookup.promise) {
+        // 由本调用方发送请求，同时到达的相同请求等待同一个结果
+        responseCache.complete(lookup, sendRequest(method, positionParams(uri, line, character)));
+    }
+    return lookup.result.get();
+}
+
+RequestAwaitable LSPClient::completion(const std::string& uri, int line, int character) {
+    return RequestAwaitable(*this, "textDocument/completion", positionParams(uri, line, character));
+}
+
+RequestAwaitable LSPClient::definition(const std::string& uri, int line, int character) {
+    return RequestAwaitable(*this, "textDocument/definition", positionParams(uri, line, character));
 }
 
 void LSPClient::documentDidSave(const std::string& uri) {
+    flushDocumentChanges(uri);
+    responseCache.invalidate(uri);
     json params = {
         {"textDocument", {
             {"uri", uri}
@@ -416,18 +1124,24 @@ void LSPClient::documentDidSave(const std::string& uri) {
 }
 
 json LSPClient::readMessage(int timeoutMs) {
+    // 缓冲区中已有完整消息时无需等待
+    {
+        std::lock_guard<std::mutex> lock(readMutex);
+        if (reader.hasFrame()) {
+            const char* body = nullptr;
+            size_t length = 0;
+            reader.next(body, length);
+            return parseFrame(body, length);
+        }
+    }
+
     // 检查是否有数据可读
-    fd_set readSet;
-    FD_ZERO(&readSet);
-    
-    int fd = fileno(serverIn);
-    FD_SET(fd, &readSet);
-    
-    struct timeval timeout;
-    timeout.tv_sec = timeoutMs / 1000;
-    timeout.tv_usec = (timeoutMs % 1000) * 1000;
-    
-    int result = select(fd + 1, &readSet, NULL, NULL, &timeout);
+    std::shared_ptr<Transport> current = currentTransport();
+    if (!current || !current->isOpen()) {
+        return json::object();
+    }
+    struct pollfd pfd = {current->readFd(), POLLIN, 0};
+    int result = poll(&pfd, 1, timeoutMs);
     
     if (result > 0) {
         // 有数据可读
@@ -439,7 +1153,9 @@ json LSPClient::readMessage(int timeoutMs) {
 }
 
 void LSPClient::updateDiagnostics(const std::string& uri, const json& diagnosticsData) {
-    diagnostics[uri] = diagnosticsData;
+    if (diagnosticsData.is_array()) {
+        diagnostics.publish(uri, diagnosticsData.get<std::vector<json>>());
+    }
 }
 
 
@@ -458,175 +1174,314 @@ json LSPClient::executeCommand(const std::string& command) {
     return sendRequest("workspace/executeCommand", params);
 }
 
+RequestAwaitable LSPClient::command(const std::string& command) {
+    return RequestAwaitable(*this, "workspace/executeCommand", {{"command", command}});
+}
+
+RequestAwaitable LSPClient::sourceName() {
+    return RequestAwaitable(*this, "workspace/executeCommand", {
+        {"command", "getAnalyzerSource"},
+        {"arguments", json::array()}
+    });
+}
+
 // 处理服务器消息
 void LSPClient::processServerMessages(int timeoutMs) {
-    json message = readMessage(timeoutMs);
-    
-    if (!message.empty()) {
-        // 输出接收到的消息（调试用）
-        std::cout << "服务器原始消息: " << message.dump(2) << std::endl;
-        
-        // 处理不同类型的消息
-        if (message.contains("method")) {
-            std::string method = message["method"];
-            
-            // 处理诊断信息
-            if (method == "textDocument/publishDiagnostics" && message.contains("params")) {
-                json params = message["params"];
-                if (params.contains("uri") && params.contains("diagnostics")) {
-                    std::string uri = params["uri"];
-                    json diagArray = params["diagnostics"];
-                    
-                    // 更新诊断信息
-                    diagnostics[uri] = diagArray;
-                    
-                    std::cout << "收到诊断信息: " << uri << " 包含 " 
-                              << diagArray.size() << " 个问题" << std::endl;
-                }
-            }
-            // 处理服务器消息
-            else if (method == "window/showMessage" && message.contains("params")) {
-                json params = message["params"];
-                if (params.contains("message")) {
-                    std::string msg = params["message"];
-                    int type = params.value("type", 1);
-                    
-                    std::cout << "服务器消息 [" << type << "]: " << msg << std::endl;
-                }
-            }
-            // 可以添加更多消息类型的处理...
+    handleMessage(readMessage(timeoutMs));
+}
+
+void LSPClient::dispatchMessage(json message) {
+    // 同一文档的消息进入同一串行队列，诊断版本不会乱序
+    std::string key;
+    auto paramsIt = message.find("params");
+    if (paramsIt != message.end() && paramsIt->is_object()) {
+        auto uriIt = paramsIt->find("uri");
+        if (uriIt != paramsIt->end() && uriIt->is_string()) {
+            key = uriIt->get<std::string>();
         }
+    }
+    handlerPool.submit(key, [this, message = std::move(message)]() mutable {
+        handleMessage(std::move(message));
+    });
+}
+
+// 按 ServerMethod 顺序排列的处理函数
+const std::array<LSPClient::MessageHandler, kServerMethodCount> LSPClient::messageHandlers = {
+    &LSPClient::onPublishDiagnostics,   // textDocument/publishDiagnostics
+    &LSPClient::onShowMessage,          // window/showMessage
+    &LSPClient::onShowMessage,          // window/showMessageRequest
+    &LSPClient::onLogMessage,           // window/logMessage
+    &LSPClient::onProgress,             // $/progress
+    &LSPClient::acknowledgeRequest,     // window/workDoneProgress/create
+    &LSPClient::onConfiguration,        // workspace/configuration
+    &LSPClient::onWorkspaceFolders,     // workspace/workspaceFolders
+    &LSPClient::onApplyEdit,            // workspace/applyEdit
+    &LSPClient::acknowledgeRequest,     // client/registerCapability
+    &LSPClient::acknowledgeRequest,     // client/unregisterCapability
+    &LSPClient::onLogMessage,           // $/logTrace
+    &LSPClient::ignoreMessage           // telemetry/event
+};
+
+void LSPClient::handleMessage(json message) {
+    if (message.empty()) {
+        return;
+    }
+    // 输出接收到的消息（调试用），在处理线程上格式化开销很大，默认不输出
+    if (traceMessages.load(std::memory_order_relaxed)) {
+        std::cout << "服务器原始消息: " << message.dump(2) << std::endl;
+    }
+
+    auto methodIt = message.find("method");
+    if (methodIt == message.end() || !methodIt->is_string()) {
         // 处理响应消息
-        else if (message.contains("id") && message.contains("result")) {
-            // 这里处理请求的响应
+        if (message.contains("id") && message.contains("result")) {
             std::cout << "收到请求响应，ID: " << message["id"] << std::endl;
         }
+        return;
     }
-}
 
-// 启动消息监听线程
-void LSPClient::startMessageListener() {
-    isRunning = true; // 设置运行标志
-    // 创建一个后台线程来监听消息
-    std::thread([this]() {
-        std::cout << "开始监听服务器日志..." << std::endl;
-        while (isRunning && serverIn != nullptr) {  // 检查运行标志
-            this->processServerMessages(100);  // 100ms超时
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const std::string& method = methodIt->get_ref<const std::string&>();
+    auto idIt = message.find("id");
+    json id = idIt != message.end() ? *idIt : json();
+
+    ServerMethod handler = lookupServerMethod(method);
+    if (handler == ServerMethod::Unknown) {
+        // 未知的服务器请求必须回复，未知的通知直接忽略
+        if (!id.is_null()) {
+            writeError(id, kMethodNotFound, "未支持的方法: " + method);
         }
-        std::cout << "服务器日志监听线程已退出" << std::endl;
-    }).detach();  
+        return;
+    }
+
+    // 参数原地交给处理函数，处理函数可以直接移走其中的内容
+    auto paramsIt = message.find("params");
+    json params = paramsIt != message.end() ? std::move(*paramsIt) : json::object();
+    (this->*messageHandlers[static_cast<size_t>(handler)])(id, params);
 }
 
-bool LSPClient::connectToServer(const std::string& host, int port) {
-    // 创建socket
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        std::cerr << "创建socket失败" << std::endl;
-        return false;
+void LSPClient::onPublishDiagnostics(const json& id, json& params) {
+    auto uriIt = params.find("uri");
+    auto diagIt = params.find("diagnostics");
+    if (uriIt == params.end() || !uriIt->is_string() || diagIt == params.end() || !diagIt->is_array()) {
+        return;
     }
+    const std::string& uri = uriIt->get_ref<const std::string&>();
+    size_t count = diagIt->size();
 
-    struct sockaddr_in serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(port);
-    
-    // 解析主机名或IP地址
-    struct hostent* server = gethostbyname(host.c_str());
-    if (server == nullptr) {
-        std::cerr << "无法解析服务器地址: " << host << std::endl;
-        close(sock);
-        return false;
+    // 发布新的诊断快照，读者无需加锁
+    diagnostics.publish(uri, std::move(diagIt->get_ref<json::array_t&>()));
+
+    std::cout << "收到诊断信息: " << uri << " 包含 " << count << " 个问题" << std::endl;
+}
+
+void LSPClient::onShowMessage(const json& id, json& params) {
+    auto msgIt = params.find("message");
+    if (msgIt != params.end() && msgIt->is_string()) {
+        int type = params.value("type", 1);
+        std::cout << "服务器消息 [" << type << "]: " << msgIt->get_ref<const std::string&>() << std::endl;
     }
-    
-    memcpy(&serverAddr.sin_addr.s_addr, server->h_addr, server->h_length);
+    // showMessageRequest 不选择任何操作
+    if (!id.is_null()) {
+        writeResponse(id, nullptr);
+    }
+}
 
-    // 连接到服务器
-    if (connect(sock, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        std::cerr << "连接服务器失败: " << host << ":" << port << std::endl;
-        close(sock);
-        return false;
+void LSPClient::onLogMessage(const json& id, json& params) {
+    auto msgIt = params.find("message");
+    if (msgIt != params.end() && msgIt->is_string()) {
+        std::cout << "服务器日志: " << msgIt->get_ref<const std::string&>() << std::endl;
     }
+}
 
-    // 将socket转换为FILE*以便使用现有代码
-    serverIn = fdopen(sock, "r");
-    serverOut = fdopen(dup(sock), "w");
-    
-    if (!serverIn || !serverOut) {
-        std::cerr << "打开服务器连接失败" << std::endl;
-        if (serverIn) fclose(serverIn);
-        if (serverOut) fclose(serverOut);
-        close(sock);
-        return false;
+void LSPClient::onProgress(const json& id, json& params) {
+    auto valueIt = params.find("value");
+    if (valueIt == params.end() || !valueIt->is_object()) {
+        return;
     }
+    const json& value = *valueIt;
+    std::cout << "服务器进度 [" << value.value("kind", "") << "] "
+              << value.value("title", value.value("message", "")) << std::endl;
+}
 
-    // 打开一个Java文件进行分析
-    std::string filePath = "/mnt/d/Course/Year4/QLextension/DemoProject-master/src/main/java/tutorial1/Main.java";
-    std::string srcPath = "/mnt/d/Course/Year4/QLextension/DemoProject-master/src";
-    std::string rootPath = "/mnt/d/Course/Year4/QLextension/DemoProject-master";
-    
-    // 使用标准URI转换
-    std::string fileUri = FileUtils::pathToUri(filePath);
-    std::string rootUri = FileUtils::pathToUri(rootPath);
+void LSPClient::onConfiguration(const json& id, json& params) {
+    // 每个配置项按 section（如 "java.project"）从已保存的配置中取值，没有对应配置时为 null
+    json result = json::array();
+    auto itemsIt = params.find("items");
+    if (itemsIt != params.end() && itemsIt->is_array()) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        for (const json& item : *itemsIt) {
+            std::string section = item.is_object() ? item.value("section", "") : "";
+            const json* value = &configuration;
+            size_t start = 0;
+            while (value && !section.empty() && start <= section.size()) {
+                size_t dot = section.find('.', start);
+                std::string name = section.substr(start, dot == std::string::npos ? std::string::npos : dot - start);
+                auto it = value->is_object() ? value->find(name) : value->end();
+                value = it != value->end() ? &*it : nullptr;
+                start = dot == std::string::npos ? section.size() + 1 : dot + 1;
+            }
+            result.push_back(value && !value->empty() ? *value : json());
+        }
+    }
+    writeResponse(id, std::move(result));
+}
 
-    // 发送初始化请求 - 与initialize方法保持一致
-    json initParams = {
-        {"processId", ::getpid()},
-        {"clientInfo", {
-            {"name", "C++ Client"},
-            {"version", "1.0"}
-        }},
-        {"rootUri", rootUri},
-        {"workspaceFolders", json::array({
-            {{"uri", rootUri}, {"name", "DemoProject"}}
-        })},
-        {"capabilities", {
-            {"workspace", {
-                {"configuration", true},
-                {"workspaceFolders", true},
-                {"didChangeConfiguration", {
-                    {"dynamicRegistration", true}
-                }}
-            }},
-            {"textDocument", {
-                {"synchronization", {
-                    {"didSave", true},
-                    {"dynamicRegistration", true}
-                }},
-                {"diagnostics", {"relatedInformation", true}}
-            }}
-        }}
+void LSPClient::onWorkspaceFolders(const json& id, json& params) {
+    // 返回 initialize 中声明的文件夹；null 表示没有打开任何文件夹，服务器会因此丢弃工作区
+    json folders;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        folders = workspaceFolders;
+    }
+    writeResponse(id, std::move(folders));
+}
+
+void LSPClient::onApplyEdit(const json& id, json& params) {
+    // 客户端不维护编辑器缓冲区，拒绝服务器发起的编辑
+    writeResponse(id, {{"applied", false}, {"failureReason", "客户端不支持 workspace/applyEdit"}});
+}
+
+void LSPClient::acknowledgeRequest(const json& id, json& params) {
+    if (!id.is_null()) {
+        writeResponse(id, nullptr);
+    }
+}
+
+void LSPClient::ignoreMessage(const json& id, json& params) {
+}
+
+bool LSPClient::writeResponse(const json& id, json result) {
+    json response = {
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"result", std::move(result)}
     };
 
-    // 发送初始化请求并等待响应
-    json response = sendRequest("initialize", initParams);
-    
-    // 检查响应是否有效
-    if (response.empty() || (response.contains("error") && !response["error"].is_null())) {
-        std::cerr << "初始化失败: " << response.dump(2) << std::endl;
-        return false;
+    // 服务器在等待回复，优先发送
+    return outbound.send(response.dump(), MessagePriority::Interactive);
+}
+
+bool LSPClient::writeError(const json& id, int code, const std::string& message) {
+    json response = {
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"error", {{"code", code}, {"message", message}}}
+    };
+
+    // 服务器在等待回复，优先发送
+    return outbound.send(response.dump(), MessagePriority::Interactive);
+}
+
+void LSPClient::onServerReadable() {
+    std::vector<json> messages;
+    bool closed = false;
+    {
+        std::lock_guard<std::mutex> lock(readMutex);
+        const char* body = nullptr;
+        size_t length = 0;
+
+        // 读到 EAGAIN 为止，每次 read 可能带来多帧
+        while (true) {
+            FrameReader::Status status;
+            while ((status = reader.next(body, length)) == FrameReader::Status::Frame) {
+                messages.push_back(parseFrame(body, length));
+            }
+            if (status != FrameReader::Status::NeedMore) {
+                closed = true;
+                break;
+            }
+            if (reader.fill() < 0) {
+                closed = errno != EAGAIN && errno != EWOULDBLOCK;
+                break;
+            }
+        }
+    }
+
+    // 响应直接交给等待中的调用方，其余消息交给处理线程池，监听线程只负责分帧和路由
+    for (auto& message : messages) {
+        if (!completeRequest(message)) {
+            dispatchMessage(std::move(message));
+        }
+    }
+
+    if (closed) {
+        if (isRunning) {
+            std::cerr << "服务器连接已关闭" << std::endl;
+        }
+        failPendingRequests();
+        if (std::shared_ptr<Transport> current = currentTransport()) {
+            loop.removeFd(current->readFd());
+        }
+        loop.stop();
+        onConnectionLost("服务器连接已关闭");
     }
-    
-    // 等待一小段时间再发送initialized通知
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    
-    // 发送initialized通知
-    sendNotification("initialized", json::object());
-    
-    // 启动消息监听器
-    startMessageListener();
-    
-    return true;
+}
+
+// 启动消息监听线程
+void LSPClient::startMessageListener() {
+    // 重新连接时先回收上一次的监听线程
+    stopMessageListener();
+    loop.clearStop();
+    isRunning = true; // 设置运行标志
+
+    // 由事件循环在可读时驱动解码
+    loop.addFd(currentTransport()->readFd(), EPOLLIN, [this](uint32_t) {
+        onServerReadable();
+    });
+
+    // 监听线程由客户端持有，关闭时唤醒并回收
+    listenerThread = std::thread([this]() {
+        std::cout << "开始监听服务器日志..." << std::endl;
+        loop.run();
+        std::cout << "服务器日志监听线程已退出" << std::endl;
+    });
+}
+
+bool LSPClient::connectToServer(const std::string& host, int port) {
+    return connectWith([host, port]() -> std::unique_ptr<Transport> {
+        return TcpTransport::connect(host, port);
+    });
+}
+
+bool LSPClient::connectToUnixSocket(const std::string& path) {
+    return connectWith([path]() -> std::unique_ptr<Transport> {
+        auto unixTransport = UnixSocketTransport::connect(path);
+        if (!unixTransport) {
+            return nullptr;
+        }
+
+        // 抽象命名空间没有文件权限保护，通过对端凭据确认服务器身份
+        const PeerCredentials& peer = unixTransport->getPeerCredentials();
+        if (peer.uid != ::geteuid() && peer.uid != 0) {
+            std::cerr << "拒绝连接: 服务器进程 " << peer.pid << " 属于其他用户 (uid=" << peer.uid << ")" << std::endl;
+            return nullptr;
+        }
+        return unixTransport;
+    });
 }
 
 // 添加心跳机制
 void LSPClient::startHeartbeat() {
-    std::thread([this]() {
-        while (isRunning && serverIn != nullptr && serverOut != nullptr) {
-            // 每30秒发送一次ping请求
-            json pingParams = {};
-            sendNotification("$/ping", pingParams);
-            std::this_thread::sleep_for(std::chrono::seconds(30));
+    heartbeatEnabled = true;
+    std::shared_ptr<Transport> current = currentTransport();
+    if (!isRunning || !current || !current->isOpen()) {
+        return;
+    }
+
+    // 往返探测：任何响应（包括 MethodNotFound 错误）都说明服务器仍在处理消息，
+    // 超时或连接失败时触发重新连接
+    sendRequestAsync("$/ping", json::object(), [this](const json& response) {
+        bool timedOut = response.contains("error") && response["error"].value("code", 0) == kRequestCancelled;
+        if (response.empty() || timedOut) {
+            onConnectionLost("心跳探测无响应");
         }
-    }).detach();
-}
+    }, kProbeTimeout);
 
+    // 定时发送下一次探测，由事件循环定时触发，发送在处理线程池中进行
+    uint64_t previous = probeTimerId.exchange(loop.addTimer(kProbeInterval, [this]() {
+        handlerPool.submit("$/ping", [this]() {
+            startHeartbeat();
+        });
+    }));
+    loop.cancelTimer(previous);
+}
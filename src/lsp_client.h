@@ -1,26 +1,128 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
 #include <nlohmann/json.hpp>
+#include "frame_reader.h"
+#include "outbound_scheduler.h"
+#include "event_loop.h"
+#include "transport.h"
+#include "lsp_coro.h"
+#include "timer_wheel.h"
+#include "pending_calls.h"
+#include "diagnostics_store.h"
+#include "message_dispatch.h"
+#include "work_pool.h"
+#include "response_cache.h"
+#include "document_store.h"
+#include "workspace_watcher.h"
 
 using json = nlohmann::json;
 
+// 会话状态，按握手顺序推进
+enum class SessionState {
+    Disconnected,  // 未连接或初始化失败
+    Initializing,  // 已发送 initialize，等待响应
+    Ready,         // 已收到响应并发送 initialized，可以正常通信
+    Reconnecting   // 连接中断，正在按退避间隔重新连接
+};
+
 class LSPClient {
 public:
     LSPClient();
     ~LSPClient();
 
-    // 连接到服务器
+    // 连接到服务器，连接中断后自动重连并恢复会话
     bool connectToServer(const std::string& host, int port);
 
+    // 通过 Unix 域套接字连接到本机服务器，'@' 开头表示抽象命名空间
+    // 服务器进程必须与当前用户相同（或为 root）
+    bool connectToUnixSocket(const std::string& path);
+
     // 初始化连接
     bool initialize(const std::string& serverPath);
+
+    // 通过任意传输层连接并完成初始化握手
+    bool connectTransport(std::unique_ptr<Transport> transport);
+
+    // 当前会话状态
+    SessionState getState();
+
+    // 等待会话就绪，超时返回 false
+    bool waitUntilReady(std::chrono::milliseconds timeout);
+
+    // 会话就绪时调用 callback，已就绪时立即调用
+    void onReady(std::function<void()> callback);
+
+    // 服务器在 initialize 响应中声明的能力
+    json getServerCapabilities();
+
+    // 与服务器协商的位置编码，公开接口中的列号均按此编码计数；服务器未声明时为 UTF-16
+    PositionEncoding getPositionEncoding() const;
+
+    // 推送工作区配置，按顶层配置节合并保存，用于回答服务器的配置查询；不是对象时整体替换
+    void changeConfiguration(const json& settings);
     
-    // 发送请求
-    json sendRequest(const std::string& method, const json& params);
+    // 响应回调，在监听线程中执行，回调内不能阻塞等待其他请求
+    using ResponseCallback = PendingCalls::Callback;
+
+    // 超时参数取该值时使用 setRequestTimeout 设置的默认截止时间
+    static constexpr std::chrono::milliseconds kDefaultTimeout{-1};
+
+    // 关闭时等待 shutdown 响应的截止时间
+    static constexpr std::chrono::milliseconds kShutdownTimeout{2000};
+
+    // 心跳探测的间隔与等待响应的截止时间
+    static constexpr std::chrono::milliseconds kProbeInterval{10000};
+    static constexpr std::chrono::milliseconds kProbeTimeout{3000};
+
+    // 重新连接的退避间隔
+    static constexpr std::chrono::milliseconds kReconnectInitialDelay{100};
+    static constexpr std::chrono::milliseconds kReconnectMaxDelay{5000};
+    // 连续失败达到该次数后放弃重连，会话进入 Disconnected
+    static constexpr int kReconnectMaxAttempts = 30;
+
+    // 重连时等待 initialize 响应的截止时间，服务器已经预热，不必等待太久
+    static constexpr std::chrono::milliseconds kReconnectHandshakeTimeout{10000};
+
+    // 超时或取消时回调收到的错误码（LSP RequestCancelled）
+    static constexpr int kRequestCancelled = -32800;
+
+    // 回复未支持的服务器请求时使用的错误码（JSON-RPC MethodNotFound）
+    static constexpr int kMethodNotFound = -32601;
+
+    // 发送请求并阻塞等待对应 id 的响应
+    json sendRequest(const std::string& method, const json& params,
+                     std::chrono::milliseconds timeout = kDefaultTimeout);
+
+    // 异步发送请求，响应按 id 送达返回的 future
+    std::future<json> sendRequestAsync(const std::string& method, const json& params,
+                                       std::chrono::milliseconds timeout = kDefaultTimeout);
+
+    // 异步发送请求，响应到达时调用 callback，返回请求 id；连接断开时以空对象回调
+    // 截止时间到达时自动发送 $/cancelRequest，回调收到 RequestCancelled 错误，迟到的响应被丢弃
+    int sendRequestAsync(const std::string& method, const json& params, ResponseCallback callback,
+                         std::chrono::milliseconds timeout = kDefaultTimeout);
+
+    // 主动取消一个等待中的请求
+    bool cancelRequest(int id);
+
+    // 设置请求的默认截止时间，0 表示不限时
+    void setRequestTimeout(std::chrono::milliseconds timeout);
+
+    // 打开后把收到的每条消息完整输出到标准输出（调试用），默认关闭
+    void setMessageTrace(bool enabled) { traceMessages = enabled; }
     
     // 读取响应
     json readResponse();
@@ -30,23 +132,69 @@ public:
     
     // 发送通知
     void sendNotification(const std::string& method, const json& params);
+
+    // 开始批量发送，之后的通知排队直到 endBatch
+    void beginBatch();
+
+    // 将排队的消息一次性发送
+    bool endBatch();
     
     // 打开文档
-    void openDocument(const std::string& uri, const std::string& text, const std::string& languageId);
+    // 文本只复制一次到文档存储，didOpen 的消息体从存储中的片段直接转义生成
+    void openDocument(const std::string& uri, std::string_view text, const std::string& languageId);
     
-    // 获取诊断信息
-    std::vector<json> getDiagnostics(const std::string& uri);
+    // 获取诊断信息快照，O(1) 且不拷贝，可在任意线程调用
+    DiagnosticsSnapshot getDiagnostics(const std::string& uri);
     
      
-    // 文档变更通知
+    // 文档变更通知，防抖窗口内同一文档的多次变更合并为一次，携带最新版本
+    // 服务器支持增量同步时只发送变化的范围
     void documentDidChange(const std::string& uri, const std::string& newContent, int version);
+
+    // 上次会话结束时工作区的状态标识（如工作区快照的根哈希），连接前设置，随 initialize 发给服务器
+    void setWorkspaceState(const std::string& state);
+
+    // 服务器在 initialize 响应中声明仍持有同一工作区状态，此时只需发送变化的文件
+    bool serverHasWorkspaceState();
+
+    // 设置变更防抖窗口，0 表示每次变更立即发送
+    void setChangeDebounce(std::chrono::milliseconds window);
+
+    // 立即发送排队中的文档变更，uri 为空时发送全部
+    void flushDocumentChanges(const std::string& uri = std::string());
+
+    // 在文档的 range 处替换为 text，版本自动加一并返回新版本，文档未打开时返回 -1
+    // 编辑直接作用于客户端保存的文档，增量同步时原样作为变更范围发送，无需整篇比较
+    int applyEdit(const std::string& uri, const TextRange& range, const std::string& text);
+
+    // 文档当前内容的只读快照，未打开时返回空指针，可在任意线程调用
+    DocumentSnapshot getDocument(const std::string& uri);
+
+    // 关闭文档，丢弃排队中的变更
+    void closeDocument(const std::string& uri);
+
+    // 监视 roots 下扩展名在 extensions 中的文件：已打开的文档从磁盘重新读取并发送 didChange 和 didSave，
+    // 其余文件的变化合并为 workspace/didChangeWatchedFiles；事件由监听线程处理
+    bool watchWorkspace(const std::vector<std::string>& roots, const std::vector<std::string>& extensions);
+
+    // 停止监视工作区
+    void stopWatchingWorkspace();
     
-    // 代码补全请求
+    // 代码补全请求，同一文档版本和位置的结果会被缓存
     json requestCompletion(const std::string& uri, int line, int character);
     
-    // 转到定义请求
+    // 转到定义请求，同一文档版本和位置的结果会被缓存
     json requestDefinition(const std::string& uri, int line, int character);
     
+    // 协程接口：co_await 得到响应，请求按 id 流水线发送，协程在执行器上恢复
+    RequestAwaitable completion(const std::string& uri, int line, int character);
+    RequestAwaitable definition(const std::string& uri, int line, int character);
+    RequestAwaitable command(const std::string& command);
+    RequestAwaitable sourceName();
+
+    // 协程恢复所在的执行器
+    CoroExecutor& getExecutor() { return executor; }
+    
     // 保存文档通知
     void documentDidSave(const std::string& uri);
     
@@ -65,27 +213,247 @@ public:
     // 启动消息监听线程
     void startMessageListener();
 
-    // 关闭连接
+    // 发送 shutdown 请求后关闭连接，服务器守护进程继续运行
     void shutdown();
     
-    // 退出服务器守护进程
+    // 发送 shutdown 请求和 exit 通知，退出服务器守护进程
     void exitServer();
 
+    // 定时发送往返探测，无响应时重新连接
     void startHeartbeat();
 private:
+    // 建立新连接的方式，用于断开后重连
+    using TransportFactory = std::function<std::unique_ptr<Transport>()>;
+
+    // 通过 factory 建立连接，并记住它用于重连
+    bool connectWith(TransportFactory factory);
+
+    // 在新传输层上完成握手，并重新推送配置和已打开的文档
+    bool openSession(std::unique_ptr<Transport> transport,
+                     std::chrono::milliseconds handshakeTimeout = kDefaultTimeout);
+
+    // 按当前版本重新打开所有文档
+    void replayDocuments();
+
+    // 发送 didOpen
+    void sendDidOpen(const std::string& uri, const Document& document);
+
+    // didOpen 消息体，文本逐片段转义后写入，不经过 json 对象
+    static std::string didOpenBody(const std::string& uri, const Document& document);
+
+    // 连接中断或探测无响应，启动重连线程
+    void onConnectionLost(const char* reason);
+    void reconnectLoop();
+
+    // 结束重连并回收重连线程
+    void stopReconnect();
+
+    // 等待正在进行的重连结束
+    void waitForReconnect(std::chrono::milliseconds timeout);
+
     // 处理服务器响应
     void handleResponse();
+
+    // 写完排队的消息，回收监听线程并关闭传输层，结束所有等待中的请求
+    void closeConnection(bool drain = true);
+
+    // 唤醒并回收监听线程
+    void stopMessageListener();
+
+    // 切换会话状态并通知等待者
+    void setState(SessionState state);
+
+    // 文本位置请求的参数
+    static json positionParams(const std::string& uri, int line, int character);
+
+    // 分配请求 id，可在任意线程调用
+    int nextRequestId();
+
+    // 出站消息的优先级，按方法名划分
+    static MessagePriority priorityOf(const std::string& method);
+
+    // 消息所属文档的 URI，用于保证同一文档的消息不被重排
+    static std::string documentKey(const json& params);
+
+    // 防抖窗口结束，在事件循环线程上触发，发送交给处理线程池
+    void onChangeDebounce(const std::string& uri);
+
+    // 变更已记入 pendingChanges，需要立即发送时返回 true，由调用方释放 changeMutex 后
+    // 调用 flushDocumentChanges；否则等待防抖窗口结束。调用方持有 changeMutex
+    bool scheduleDidChange(const std::string& uri);
+
+    // 从排队的变更得到待发送的 didChange，并把 syncedDocuments 更新为发送后的内容；调用方持有 changeMutex
+    struct PendingChange;
+    struct OutgoingChange;
+    void takeChange(const std::string& uri, PendingChange& change, std::vector<OutgoingChange>& outgoing);
+
+    // 发送一次 didChange，按服务器声明的同步方式发送全量内容或增量范围；
+    // 不持有 changeMutex，调用方持有 syncMutex 以保证版本按序发出
+    void sendDidChange(const OutgoingChange& change);
+
+    // 一批合并后的文件变化，在处理线程池中按批次顺序执行
+    void onWorkspaceChanges(const std::vector<FileChange>& changes);
+
+    // 经过响应缓存的位置请求
+    json cachedRequest(const std::string& method, const std::string& uri, int line, int character);
+
+    // 写出一条请求
+    bool writeRequest(int id, const std::string& method, const json& params);
+
+    // 按 id 将响应交给等待者，不是待处理请求的响应时返回 false
+    bool completeRequest(const json& message);
+
+    // 从等待表中取出请求并撤销其截止时间
+    ResponseCallback takePendingRequest(int id);
+
+    // 放弃请求：通知服务器取消（notifyServer 为 false 时不发送），并以 RequestCancelled 错误结束等待者
+    bool abandonRequest(int id, const char* reason, bool notifyServer = true);
+
+    // 截止时间到达，cancellable 为 false 的请求不向服务器发送 $/cancelRequest
+    void expireRequest(int id, bool cancellable);
+
+    // 撤销截止时间定时器，timerId 为 0 时忽略
+    void cancelDeadline(uint64_t timerId);
+
+    // 时间轮非空时安排下一次推进，调用方持有 deadlineMutex
+    void armDeadlineTimer();
+    void onDeadlineTick();
+
+    // 连接断开时以空对象结束所有等待中的请求
+    void failPendingRequests();
+
+    // 解析一帧消息体
+    json parseFrame(const char* body, size_t length);
+
+    // 把一条服务器消息交给处理线程池，按文档 URI 保序
+    void dispatchMessage(json message);
+
+    // 分发一条服务器消息，按方法名的完美哈希查表选择处理函数
+    void handleMessage(json message);
+
+    // 服务器消息处理函数，id 为 null 表示通知；params 归消息所有，可直接移走
+    using MessageHandler = void (LSPClient::*)(const json& id, json& params);
+    static const std::array<MessageHandler, kServerMethodCount> messageHandlers;
+
+    void onPublishDiagnostics(const json& id, json& params);
+    void onShowMessage(const json& id, json& params);
+    void onLogMessage(const json& id, json& params);
+    void onProgress(const json& id, json& params);
+    void onConfiguration(const json& id, json& params);
+    void onWorkspaceFolders(const json& id, json& params);
+    void onApplyEdit(const json& id, json& params);
+    void acknowledgeRequest(const json& id, json& params);
+    void ignoreMessage(const json& id, json& params);
+
+    // 回复服务器发来的请求
+    bool writeResponse(const json& id, json result);
+    bool writeError(const json& id, int code, const std::string& message);
+
+    // 服务器 fd 可读时由事件循环调用
+    void onServerReadable();
     
-    // 读写管道
-    FILE* serverIn;
-    FILE* serverOut;
+    // 与服务器通信的传输层；重连线程会替换它，其他线程通过 currentTransport 取得副本后再使用
+    std::mutex transportMutex;
+    std::shared_ptr<Transport> transport;
+    std::shared_ptr<Transport> currentTransport();
+
+    // 服务器消息解码器
+    FrameReader reader;
+
+    // 客户端消息按优先级调度写出
+    OutboundScheduler outbound;
+
+    // 保护 reader，监听线程与调用线程共用同一连接
+    std::mutex readMutex;
+
+    // 监听线程运行的事件循环
+    EventLoop loop;
     
-    // 请求ID
-    int requestId;
+    // 工作区文件监视，注册在 loop 上
+    WorkspaceWatcher watcher;
+
+    // 请求ID，多线程并发分配
+    std::atomic<int> requestId;
     
-    // 消息监听线程
+    // 消息监听线程及其运行标志
+    std::thread listenerThread;
     std::atomic<bool> isRunning; 
+
+    // 等待响应的请求，按 JSON-RPC id 分片索引
+    PendingCalls pendingCalls;
+
+    // 是否输出收到的原始消息
+    std::atomic<bool> traceMessages;
+
+    // 请求截止时间
+    std::atomic<long long> requestTimeoutMs;
+    std::mutex deadlineMutex;
+    TimerWheel deadlines;
+    uint64_t deadlineTimerId;  // 推进时间轮的事件循环定时器，0 表示未启动
+
+    // 等待防抖发送的文档变更
+    struct PendingChange {
+        DocumentSnapshot document;      // 最新内容
+        json edits = json::array();     // applyEdit 累积的范围编辑，按发生顺序
+        bool fullText = false;          // 期间整篇替换过，需要与服务器上的内容比较
+        uint64_t timerId = 0;
+    };
+    // 已从队列取出、等待计算和发送的 didChange
+    struct OutgoingChange {
+        std::string uri;
+        DocumentSnapshot document;      // 发送后服务器上的内容
+        DocumentSnapshot baseline;      // 非空时与其比较得到增量范围
+        json edits;                     // 非空时直接发送这些范围编辑
+    };
+    std::atomic<long long> changeDebounceMs;
+    std::mutex changeMutex;
+    std::unordered_map<std::string, PendingChange> pendingChanges;
+    // 串行化 didChange 的计算和写出；先于 changeMutex 获取，事件循环线程上不持有
+    std::mutex syncMutex;
+
+    // 服务器声明的文档同步方式（TextDocumentSyncKind）
+    static constexpr int kSyncNone = 0;
+    static constexpr int kSyncFull = 1;
+    static constexpr int kSyncIncremental = 2;
+    std::atomic<int> textSyncKind;
+
+    // 协商的位置编码，初始化时按服务器的 positionEncoding 设置
+    std::atomic<PositionEncoding> positionEncoding;
+
+    // 增量同步时服务器上的文档快照，受 changeMutex 保护
+    std::unordered_map<std::string, DocumentSnapshot> syncedDocuments;
+
+    // 补全与定义请求的响应缓存
+    ResponseCache responseCache;
+
+    // 已打开的文档，重新连接时按当前版本重新打开
+    DocumentStore documents;
+
+    // 自动重连
+    std::mutex reconnectMutex;
+    TransportFactory transportFactory;
+    std::thread reconnectThread;
+    std::atomic<bool> reconnecting;
+    std::atomic<bool> closingSession;
+    std::atomic<bool> heartbeatEnabled;
+    std::atomic<uint64_t> probeTimerId;
+
+    // 会话状态、服务器能力与已推送的配置
+    std::mutex stateMutex;
+    std::condition_variable stateChanged;
+    SessionState sessionState;
+    std::vector<std::function<void()>> readyCallbacks;
+    json serverCapabilities;
+    json configuration;
+    json workspaceFolders;  // initialize 中声明的工作区文件夹
+    std::string workspaceState;
+
+    // 协程执行器
+    CoroExecutor executor;
     
     // 存储诊断信息
-    std::unordered_map<std::string, std::vector<json>> diagnostics;
+    DiagnosticsStore diagnostics;
+
+    // 服务器消息处理线程池，最后声明以便最先析构，析构时其余成员仍然有效
+    WorkPool handlerPool;
 };
\ No newline at end of file
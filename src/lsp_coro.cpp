@@ -0,0 +1,57 @@
+#include "lsp_coro.h"
+#include "lsp_client.h"
+
+CoroExecutor::CoroExecutor(size_t threadCount)
+    : threadCount(threadCount == 0 ? 1 : threadCount), stopping(false) {}
+
+CoroExecutor::~CoroExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void CoroExecutor::start() {
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+void CoroExecutor::post(std::coroutine_handle<> handle) {
+    std::call_once(started, [this]() { start(); });
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(handle);
+    }
+    ready.notify_one();
+}
+
+void CoroExecutor::workerLoop() {
+    while (true) {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this]() { return stopping || !queue.empty(); });
+            // 退出时仍挂起的协程不再恢复
+            if (stopping) {
+                return;
+            }
+            handle = queue.front();
+            queue.pop_front();
+        }
+        handle.resume();
+    }
+}
+
+void RequestAwaitable::await_suspend(std::coroutine_handle<> handle) {
+    // 回调在监听线程中执行，只保存响应并把协程交回执行器
+    CoroExecutor& executor = client.getExecutor();
+    client.sendRequestAsync(method, params, [this, handle, &executor](const json& result) {
+        response = result;
+        executor.post(handle);
+    });
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+class LSPClient;
+
+// 协程执行器
+// 少量线程从队列中取出挂起的协程恢复执行；响应到达后协程被投递到这里，
+// 不会在监听线程上运行用户代码。线程在第一次投递时才创建
+class CoroExecutor {
+public:
+    explicit CoroExecutor(size_t threadCount = 1);
+    ~CoroExecutor();
+
+    CoroExecutor(const CoroExecutor&) = delete;
+    CoroExecutor& operator=(const CoroExecutor&) = delete;
+
+    // 投递一个待恢复的协程
+    void post(std::coroutine_handle<> handle);
+
+private:
+    void start();
+    void workerLoop();
+
+    size_t threadCount;
+    std::once_flag started;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::coroutine_handle<>> queue;
+    std::vector<std::thread> workers;
+    bool stopping;
+};
+
+namespace detail {
+
+// Task 的公共 promise 部分：惰性启动，结束时对称转移到等待者
+struct TaskPromiseBase {
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    void return_value(T result) { value = std::move(result); }
+
+    T take() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+
+    std::optional<T> value;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    void return_void() const noexcept {}
+
+    void take() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+}  // namespace detail
+
+// 惰性协程任务，被 co_await 或 spawn 时才开始执行
+template <typename T = void>
+class Task {
+public:
+    struct promise_type : detail::TaskPromise<T> {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle.promise().continuation = continuation;
+        return handle;
+    }
+
+    T await_resume() { return handle.promise().take(); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail {
+
+// 自行销毁的顶层协程，用于从普通代码启动 Task
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() {
+            return DetachedTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+DetachedTask runTask(Task<T> task, std::promise<T> result) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(task);
+            result.set_value();
+        } else {
+            result.set_value(co_await std::move(task));
+        }
+    } catch (...) {
+        result.set_exception(std::current_exception());
+    }
+}
+
+}  // namespace detail
+
+// 在执行器上启动任务，结果通过 future 返回
+template <typename T>
+std::future<T> spawn(CoroExecutor& executor, Task<T> task) {
+    std::promise<T> result;
+    std::future<T> future = result.get_future();
+    executor.post(detail::runTask(std::move(task), std::move(result)).handle);
+    return future;
+}
+
+// 启动任务并阻塞等待结果，不能在执行器线程中调用
+template <typename T>
+T syncWait(CoroExecutor& executor, Task<T> task) {
+    return spawn(executor, std::move(task)).get();
+}
+
+// 等待一次 LSP 请求的响应
+// 挂起时发出请求，响应按 id 送达后协程在客户端的执行器上恢复
+class RequestAwaitable {
+public:
+    RequestAwaitable(LSPClient& client, std::string method, json params)
+        : client(client), method(std::move(method)), params(std::move(params)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+    json await_resume() { return std::move(response); }
+
+private:
+    LSPClient& client;
+    std::string method;
+    json params;
+    json response;
+};
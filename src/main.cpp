@@ -1,5 +1,8 @@
 #include "lsp_client.h"
 #include "file_utils.h"
+#include "file_view.h"
+#include "workspace_loader.h"
+#include "workspace_snapshot.h"
 #include <nlohmann/json.hpp>
 #include <iostream>
 #include <string>
@@ -12,9 +15,25 @@
 #include <netdb.h>
 #include <ctime> // 新增头文件
 
-int main() {
+int main(int argc, char** argv) {
+    // --bulk: 打开源代码目录下的全部 Java 文件，而不只是 Main.java
+    bool bulkOpen = argc > 1 && std::string(argv[1]) == "--bulk";
+
     // 创建LSP客户端
     LSPClient client;
+
+    // 打开一个Java文件进行分析
+    std::string filePath = "/mnt/d/Course/Year4/QLextension/DemoProject-master/src/main/java/tutorial1/Main.java";
+    std::string srcPath = "/mnt/d/Course/Year4/QLextension/DemoProject-master/src";
+    std::string rootPath = "/mnt/d/Course/Year4/QLextension/DemoProject-master";
+
+    // 批量模式下读取上次会话的工作区快照，服务器仍持有同一状态时只需发送变化的文件
+    std::string snapshotPath = rootPath + "/.lsp-workspace-snapshot.json";
+    WorkspaceSnapshot previousSnapshot;
+    bool warmStart = bulkOpen && WorkspaceSnapshot::load(snapshotPath, previousSnapshot);
+    if (warmStart) {
+        client.setWorkspaceState(previousSnapshot.rootHash());
+    }
     
     // 连接到已运行的服务器
     std::string serverHost = "172.19.112.1"; 
@@ -28,40 +47,39 @@ int main() {
     }
     std::cout << "成功连接到服务器" << std::endl;
     
-    // 打开一个Java文件进行分析
-    std::string filePath = "/mnt/d/Course/Year4/QLextension/DemoProject-master/src/main/java/tutorial1/Main.java";
-    std::string srcPath = "/mnt/d/Course/Year4/QLextension/DemoProject-master/src";
-    std::string rootPath = "/mnt/d/Course/Year4/QLextension/DemoProject-master";
-
     // 使用标准URI转换
     std::string fileUri = FileUtils::pathToUri(filePath);
     std::string rootUri = FileUtils::pathToUri(rootPath);
-    // 读取文件内容
-    std::string fileContent = FileUtils::readFile(filePath);
+    // 读取文件内容，大文件直接映射
+    FileView fileContent;
+    if (!bulkOpen && !fileContent.open(filePath)) {
+        std::cerr << "无法读取文件: " << filePath << std::endl;
+    }
     
+    // 两次配置推送合并为一次写出
+    client.beginBatch();
+
     // 发送工作区配置
-    client.sendNotification("workspace/didChangeConfiguration", {
-        {"settings", {
-            {"java", {
-                {"sourcePaths", json::array({
-                    FileUtils::pathToUri(srcPath)
-                })},
-                {"libraryPaths", json::array()},
-                {"project", {
-                    {"name", "DemoProject"},
-                    {"type", "maven"},
-                    {"dependencies", json::array()},
-                    // 添加构建文件绝对路径
-                    {"buildFile", FileUtils::pathToUri(rootPath + "/pom.xml")}
-                }},
-                {"analysis", {
-                    {"level", "full"},
-                    {"target", "java8"},
-                    // 添加依赖解析配置
-                    {"dependencyResolution", {
-                        {"mode", "hybrid"},
-                        {"mavenHome", "/root/.m2"} // 使用Linux路径
-                    }}
+    client.changeConfiguration({
+        {"java", {
+            {"sourcePaths", json::array({
+                FileUtils::pathToUri(srcPath)
+            })},
+            {"libraryPaths", json::array()},
+            {"project", {
+                {"name", "DemoProject"},
+                {"type", "maven"},
+                {"dependencies", json::array()},
+                // 添加构建文件绝对路径
+                {"buildFile", FileUtils::pathToUri(rootPath + "/pom.xml")}
+            }},
+            {"analysis", {
+                {"level", "full"},
+                {"target", "java8"},
+                // 添加依赖解析配置
+                {"dependencyResolution", {
+                    {"mode", "hybrid"},
+                    {"mavenHome", "/root/.m2"} // 使用Linux路径
                 }}
             }}
         }}
@@ -81,28 +99,62 @@ int main() {
         }}
     };
 
-    client.sendNotification("workspace/didChangeConfiguration", {
-        {"settings", config}
-    });
+    client.changeConfiguration(config);
+    client.endBatch();
 
     
     // 在初始化后添加Maven项目验证
     std::string mvnCmd = "mvn -f \"" + rootPath + "/pom.xml\" validate";
     std::system(mvnCmd.c_str());
     
-    // 等待一段时间，确保服务器处理配置
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-
-    // 打开文档并等待分析
-    client.openDocument(fileUri, fileContent, "java");
+    // 打开文档并等待分析；配置与 didOpen 在同一连接上按序到达，无需额外等待
+    if (bulkOpen) {
+        WorkspaceLoader loader(client);
+        WorkspaceLoader::Stats stats;
+        WorkspaceSnapshot snapshot = WorkspaceSnapshot::scan({srcPath}, {".java"},
+                                                             warmStart ? &previousSnapshot : nullptr);
+        if (warmStart && client.serverHasWorkspaceState()) {
+            // 只打开新建和修改的文件，删除的文件通过 didChangeWatchedFiles 告知
+            std::vector<std::string> changedFiles;
+            json deletedFiles = json::array();
+            for (const FileChange& change : snapshot.diff(previousSnapshot)) {
+                if (change.type == FileChangeType::Deleted) {
+                    deletedFiles.push_back({{"uri", FileUtils::pathToUri(change.path)}, {"type", 3}});
+                } else {
+                    changedFiles.push_back(change.path);
+                }
+            }
+            std::cout << "工作区快照命中，" << snapshot.fileCount() << " 个文件中 " << changedFiles.size()
+                      << " 个有变化，" << deletedFiles.size() << " 个已删除" << std::endl;
+            if (!deletedFiles.empty()) {
+                client.sendNotification("workspace/didChangeWatchedFiles", {{"changes", deletedFiles}});
+            }
+            stats = loader.openFiles(changedFiles, "java");
+        } else {
+            stats = loader.open({srcPath}, {".java"}, "java");
+        }
+        snapshot.save(snapshotPath);
+        std::cout << "批量打开 " << stats.files << " 个文件，" << stats.bytes / 1024 << " KB，耗时 "
+                  << stats.elapsed.count() << " ms，" << stats.filesPerSecond() << " 文件/秒，"
+                  << stats.megabytesPerSecond() << " MB/秒";
+        if (stats.failed > 0) {
+            std::cout << "，" << stats.failed << " 个文件读取失败";
+        }
+        std::cout << std::endl;
+    } else {
+        client.openDocument(fileUri, fileContent.view(), "java");
+    }
     
+    // 源代码目录中的改动由监视器同步给服务器
+    client.watchWorkspace({srcPath}, {".java"});
+
     std::cout << "等待分析结果..." << std::endl;
 
     int waitTimeSeconds = 5; 
     for (int i = 0; i < waitTimeSeconds; i++) {
         // 检查是否已经收到诊断信息
         auto diagnostics = client.getDiagnostics(fileUri);
-        if (!diagnostics.empty()) {
+        if (!diagnostics->empty()) {
             std::cout << "已收到诊断信息，停止等待" << std::endl;
             break;
         }
@@ -120,9 +172,9 @@ int main() {
     
     // 获取诊断结果
     auto diagnostics = client.getDiagnostics(fileUri);
-    std::cout << "收到 " << diagnostics.size() << " 条诊断信息" << std::endl;
+    std::cout << "收到 " << diagnostics->size() << " 条诊断信息" << std::endl;
     
-    for (const auto& diag : diagnostics) {
+    for (const auto& diag : *diagnostics) {
         std::cout << "诊断: " << diag.dump(2) << std::endl;
     }
      
@@ -131,10 +183,6 @@ int main() {
     // 关闭连接
     client.shutdown();
     
-    // 添加强制退出代码
     std::cout << "程序即将退出..." << std::endl;
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // 给一点时间让消息打印出来
-    // exit(0); // 强制退出程序
-    
     return 0;
 }
\ No newline at end of file
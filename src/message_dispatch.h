@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 客户端处理的服务器消息，新增方法时同时补充 kServerMethodNames
+enum class ServerMethod : uint8_t {
+    PublishDiagnostics,
+    ShowMessage,
+    ShowMessageRequest,
+    LogMessage,
+    Progress,
+    WorkDoneProgressCreate,
+    Configuration,
+    WorkspaceFolders,
+    ApplyEdit,
+    RegisterCapability,
+    UnregisterCapability,
+    LogTrace,
+    Telemetry,
+    Count,
+    Unknown = Count
+};
+
+inline constexpr size_t kServerMethodCount = static_cast<size_t>(ServerMethod::Count);
+
+inline constexpr std::array<std::string_view, kServerMethodCount> kServerMethodNames = {
+    "textDocument/publishDiagnostics",
+    "window/showMessage",
+    "window/showMessageRequest",
+    "window/logMessage",
+    "$/progress",
+    "window/workDoneProgress/create",
+    "workspace/configuration",
+    "workspace/workspaceFolders",
+    "workspace/applyEdit",
+    "client/registerCapability",
+    "client/unregisterCapability",
+    "$/logTrace",
+    "telemetry/event"
+};
+
+// 方法名到 ServerMethod 的完美哈希，种子与表在编译期求出
+// 查找只需一次哈希、一次取模和一次字符串比较，与方法数量无关
+namespace method_hash {
+
+inline constexpr size_t kTableSize = 32;
+static_assert(kTableSize >= kServerMethodCount, "完美哈希表容量不足");
+
+constexpr uint32_t fnv1a(std::string_view text, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : text) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    // FNV 的低位只取决于输入的低位，取模前先混合高位
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+constexpr size_t slotOf(std::string_view text, uint32_t seed) {
+    return fnv1a(text, seed) % kTableSize;
+}
+
+constexpr bool collisionFree(uint32_t seed) {
+    std::array<bool, kTableSize> used{};
+    for (std::string_view name : kServerMethodNames) {
+        size_t slot = slotOf(name, seed);
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+// 依次尝试种子，找不到时返回 0 并由 static_assert 报错
+constexpr uint32_t findSeed() {
+    for (uint32_t seed = 1; seed < 100000; ++seed) {
+        if (collisionFree(seed)) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+inline constexpr uint32_t kSeed = findSeed();
+static_assert(kSeed != 0, "无法为服务器方法名找到完美哈希种子，请增大 kTableSize");
+
+constexpr std::array<ServerMethod, kTableSize> buildTable() {
+    std::array<ServerMethod, kTableSize> table{};
+    for (ServerMethod& entry : table) {
+        entry = ServerMethod::Unknown;
+    }
+    for (size_t i = 0; i < kServerMethodCount; ++i) {
+        table[slotOf(kServerMethodNames[i], kSeed)] = static_cast<ServerMethod>(i);
+    }
+    return table;
+}
+
+inline constexpr std::array<ServerMethod, kTableSize> kTable = buildTable();
+
+} // namespace method_hash
+
+// 查找方法名，未登记的方法返回 ServerMethod::Unknown
+constexpr ServerMethod lookupServerMethod(std::string_view method) {
+    ServerMethod candidate = method_hash::kTable[method_hash::slotOf(method, method_hash::kSeed)];
+    if (candidate == ServerMethod::Unknown ||
+        kServerMethodNames[static_cast<size_t>(candidate)] != method) {
+        return ServerMethod::Unknown;
+    }
+    return candidate;
+}
+
+// 每个登记的方法都必须能查回自身
+constexpr bool allServerMethodsResolve() {
+    for (size_t i = 0; i < kServerMethodCount; ++i) {
+        if (lookupServerMethod(kServerMethodNames[i]) != static_cast<ServerMethod>(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(allServerMethodsResolve(), "kServerMethodNames 与 ServerMethod 不一致");
+static_assert(lookupServerMethod("textDocument/publishDiagnostics") == ServerMethod::PublishDiagnostics);
+static_assert(lookupServerMethod("$/progress") == ServerMethod::Progress);
+static_assert(lookupServerMethod("textDocument/unknown") == ServerMethod::Unknown);
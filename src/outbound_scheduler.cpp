@@ -0,0 +1,211 @@
+#include "outbound_scheduler.h"
+
+OutboundScheduler::OutboundScheduler()
+    : bulkBytes(0), nextSequence(0), writing(false), holding(false), failed(false), stopping(false) {
+    thread = std::thread([this]() { run(); });
+}
+
+OutboundScheduler::~OutboundScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    writer.interrupt();
+    wake.notify_all();
+    drained.notify_all();
+    thread.join();
+}
+
+void OutboundScheduler::reset(Transport* transport) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (writing) {
+        // 写入可能因对端不再读取而无限阻塞，唤醒它放弃当前这组帧
+        writer.interrupt();
+    }
+    drained.wait(lock, [this]() { return !writing; });
+    for (auto& queue : queues) {
+        queue.clear();
+    }
+    bulkBytes = 0;
+    holding = false;
+    failed = false;
+    writer.reset(transport);
+}
+
+bool OutboundScheduler::hasQueued() const {
+    for (const auto& queue : queues) {
+        if (!queue.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool OutboundScheduler::send(std::string body, MessagePriority priority, std::string key, int requestId) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (priority == MessagePriority::Bulk) {
+        // 写出跟不上时让批量调用方等待，而不是无限堆积在内存中
+        drained.wait(lock, [this]() { return bulkBytes < kBulkLimit || failed || stopping; });
+    }
+    if (failed) {
+        return false;
+    }
+
+    Frame frame{std::move(body), std::move(key), nextSequence++, requestId};
+
+    // 线路空闲且没有排队的消息时直接在调用线程写出，省去一次线程切换
+    if (!writing && !holding && !hasQueued()) {
+        writing = true;
+        lock.unlock();
+        std::deque<Frame> group;
+        group.push_back(std::move(frame));
+        bool ok = writeGroup(group);
+        lock.lock();
+        writing = false;
+        if (!ok) {
+            failed = true;
+        }
+        if (hasQueued()) {
+            wake.notify_one();
+        }
+        drained.notify_all();
+        return ok;
+    }
+
+    if (priority == MessagePriority::Bulk) {
+        bulkBytes += frame.body.size();
+    }
+    queues[static_cast<size_t>(priority)].push_back(std::move(frame));
+    if (!writing && !holding) {
+        wake.notify_one();
+    }
+    return true;
+}
+
+void OutboundScheduler::hold() {
+    std::lock_guard<std::mutex> lock(mutex);
+    holding = true;
+}
+
+bool OutboundScheduler::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!holding) {
+            return !failed;
+        }
+        holding = false;
+    }
+    wake.notify_one();
+    return true;
+}
+
+bool OutboundScheduler::drain(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto done = [this]() {
+        return failed || stopping || (!writing && (holding || !hasQueued()));
+    };
+    if (timeout.count() > 0) {
+        if (!drained.wait_for(lock, timeout, done)) {
+            return false;
+        }
+    } else {
+        drained.wait(lock, done);
+    }
+    return !failed;
+}
+
+bool OutboundScheduler::withdraw(int requestId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t p = 0; p < kPriorityCount; ++p) {
+        auto& queue = queues[p];
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (it->requestId != requestId) {
+                continue;
+            }
+            if (p == static_cast<size_t>(MessagePriority::Bulk)) {
+                bulkBytes -= it->body.size();
+                drained.notify_all();
+            }
+            queue.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+OutboundScheduler::Frame OutboundScheduler::takeNext() {
+    for (size_t p = 0; p < kPriorityCount; ++p) {
+        if (queues[p].empty()) {
+            continue;
+        }
+
+        // 同一文档在更低优先级队列中更早的消息必须先发
+        size_t bestQueue = p;
+        auto best = queues[p].begin();
+        if (!best->key.empty()) {
+            for (size_t q = p + 1; q < kPriorityCount; ++q) {
+                for (auto it = queues[q].begin(); it != queues[q].end(); ++it) {
+                    if (it->key == best->key) {
+                        if (it->sequence < best->sequence) {
+                            bestQueue = q;
+                            best = it;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        Frame frame = std::move(*best);
+        queues[bestQueue].erase(best);
+        if (bestQueue == static_cast<size_t>(MessagePriority::Bulk)) {
+            bulkBytes -= frame.body.size();
+        }
+        return frame;
+    }
+    return Frame{};
+}
+
+bool OutboundScheduler::writeGroup(std::deque<Frame>& group) {
+    if (group.size() == 1) {
+        return writer.writeFrame(std::move(group.front().body));
+    }
+    writer.beginBatch();
+    for (Frame& frame : group) {
+        writer.writeFrame(std::move(frame.body));
+    }
+    return writer.flush();
+}
+
+void OutboundScheduler::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || (!writing && !holding && hasQueued()); });
+        if (stopping) {
+            return;
+        }
+
+        // 按优先级取出一组帧合并写出，写出期间新到的高优先级消息在下一组最先发送
+        writing = true;
+        std::deque<Frame> group;
+        size_t bytes = 0;
+        do {
+            group.push_back(takeNext());
+            bytes += group.back().body.size();
+        } while (hasQueued() && bytes < kGroupBytes);
+
+        lock.unlock();
+        bool ok = writeGroup(group);
+        lock.lock();
+        writing = false;
+        if (!ok) {
+            // 连接已断开，丢弃剩余消息，之后的发送直接失败
+            failed = true;
+            for (auto& queue : queues) {
+                queue.clear();
+            }
+            bulkBytes = 0;
+        }
+        drained.notify_all();
+    }
+}
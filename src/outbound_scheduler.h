@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "frame_writer.h"
+
+class Transport;
+
+// 出站消息的优先级
+enum class MessagePriority : uint8_t {
+    Interactive,  // 用户正在等待的请求：补全、跳转定义、取消、对服务器请求的回复
+    Normal,       // 其余请求与通知
+    Bulk          // 批量打开工作区等大块流量
+};
+
+// 出站消息调度器
+// 消息按优先级排队，每次在帧边界重新挑选最高优先级的消息，
+// 高优先级的消息最多等待一组正在写出的帧（最多 kGroupBytes 字节，或单个超大帧）。
+// 同一文档的消息不会越过该文档更早排队的消息，didChange 之后的补全请求仍然看到新内容。
+// 线路空闲时调用方直接写出，否则交给后台写线程；批量流量超过 kBulkLimit 时阻塞调用方
+class OutboundScheduler {
+public:
+    OutboundScheduler();
+    ~OutboundScheduler();
+
+    OutboundScheduler(const OutboundScheduler&) = delete;
+    OutboundScheduler& operator=(const OutboundScheduler&) = delete;
+
+    // 重新绑定传输层，丢弃排队中的消息；正在进行的写入被中断
+    void reset(Transport* transport);
+
+    // 发送一帧；key 为消息所属文档的 URI，没有时为空；requestId 为请求的 id，不是请求时为 0。
+    // 写入失败后返回 false
+    bool send(std::string body, MessagePriority priority, std::string key = std::string(), int requestId = 0);
+
+    // 撤回仍在排队、尚未写出的请求，撤回成功时服务器不会收到它
+    bool withdraw(int requestId);
+
+    // 暂停写出，之后的消息排队直到 release
+    void hold();
+
+    // 恢复写出，唤醒写线程后立即返回，不等待队列写完（需要时再调用 drain）
+    bool release();
+
+    // 等待排队的消息全部写出；timeout 大于 0 时最多等待该时长，超时返回 false
+    bool drain(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+private:
+    struct Frame {
+        std::string body;
+        std::string key;
+        uint64_t sequence;
+        int requestId;
+    };
+
+    static constexpr size_t kPriorityCount = 3;
+
+    // 一次 writev 合并写出的字节上限，也是高优先级消息的最大等待量
+    static constexpr size_t kGroupBytes = 64 * 1024;
+
+    // 排队中的批量流量上限
+    static constexpr size_t kBulkLimit = 8 * 1024 * 1024;
+
+    bool hasQueued() const;
+
+    // 取出下一帧，调用方持有 mutex
+    Frame takeNext();
+
+    // 写出一组帧，调用方持有 writing 标记但不持有 mutex
+    bool writeGroup(std::deque<Frame>& group);
+
+    void run();
+
+    FrameWriter writer;
+
+    std::mutex mutex;
+    std::condition_variable wake;     // 唤醒写线程
+    std::condition_variable drained;  // 通知等待排空或批量限流的调用方
+    std::array<std::deque<Frame>, kPriorityCount> queues;
+    size_t bulkBytes;
+    uint64_t nextSequence;
+    bool writing;
+    bool holding;
+    bool failed;
+    bool stopping;
+
+    std::thread thread;
+};
@@ -0,0 +1,68 @@
+#include "pending_calls.h"
+
+bool PendingCalls::add(int id, Callback&& callback, uint64_t timerId, const std::atomic<bool>& accepting) {
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // 在分片锁内检查，与 takeAll 配合保证断开后登记的请求不会被遗漏
+    if (!accepting) {
+        return false;
+    }
+    shard.calls[id] = Entry{std::move(callback), timerId};
+    return true;
+}
+
+bool PendingCalls::take(int id, Callback& callback, uint64_t& timerId) {
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.calls.find(id);
+    if (it == shard.calls.end()) {
+        return false;
+    }
+    callback = std::move(it->second.callback);
+    timerId = it->second.timerId;
+    shard.calls.erase(it);
+    return true;
+}
+
+PendingCalls::Lookup PendingCalls::takeForResponse(int id, Callback& callback, uint64_t& timerId) {
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.abandoned.erase(id) > 0) {
+        return Lookup::Abandoned;
+    }
+    auto it = shard.calls.find(id);
+    if (it == shard.calls.end()) {
+        return Lookup::Missing;
+    }
+    callback = std::move(it->second.callback);
+    timerId = it->second.timerId;
+    shard.calls.erase(it);
+    return Lookup::Found;
+}
+
+bool PendingCalls::abandon(int id, Callback& callback, uint64_t& timerId) {
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.calls.find(id);
+    if (it == shard.calls.end()) {
+        return false;
+    }
+    callback = std::move(it->second.callback);
+    timerId = it->second.timerId;
+    shard.calls.erase(it);
+    shard.abandoned.insert(id);
+    return true;
+}
+
+std::vector<PendingCalls::Callback> PendingCalls::takeAll() {
+    std::vector<Callback> callbacks;
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& entry : shard.calls) {
+            callbacks.push_back(std::move(entry.second.callback));
+        }
+        shard.calls.clear();
+        shard.abandoned.clear();
+    }
+    return callbacks;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// 等待响应的请求表
+// 按 JSON-RPC id 分片，每片一把锁；请求 id 连续递增，
+// 多个线程同时发请求、监听线程同时完成请求时几乎不会落在同一分片上
+class PendingCalls {
+public:
+    using Callback = std::function<void(const json& response)>;
+
+    // 响应到达时的查找结果
+    enum class Lookup {
+        Found,      // 取出了等待者
+        Abandoned,  // 请求已超时或取消，响应应丢弃
+        Missing     // 不是客户端发出的请求
+    };
+
+    // 登记请求；accepting 为 false 时拒绝，用于连接断开后不再接受新请求
+    // 只有登记成功时才取走 callback，被拒绝时调用方仍可使用它
+    bool add(int id, Callback&& callback, uint64_t timerId, const std::atomic<bool>& accepting);
+
+    // 取出请求，不存在时返回 false
+    bool take(int id, Callback& callback, uint64_t& timerId);
+
+    // 响应到达时取出请求，或识别出已放弃的请求
+    Lookup takeForResponse(int id, Callback& callback, uint64_t& timerId);
+
+    // 取出请求并记录为已放弃，其迟到的响应将被丢弃；两步在同一把分片锁内完成，
+    // 避免响应恰好在两步之间到达时 id 永远留在已放弃集合中。请求不存在时返回 false
+    bool abandon(int id, Callback& callback, uint64_t& timerId);
+
+    // 取出全部等待者并清空，用于连接断开
+    std::vector<Callback> takeAll();
+
+private:
+    struct Entry {
+        Callback callback;
+        uint64_t timerId;  // 截止时间定时器，0 表示不限时
+    };
+
+    // 按缓存行对齐，避免相邻分片的锁互相干扰
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<int, Entry> calls;
+        std::unordered_set<int> abandoned;
+    };
+
+    static constexpr size_t kShardCount = 16;
+
+    Shard& shardFor(int id) { return shards[static_cast<unsigned>(id) % kShardCount]; }
+
+    std::array<Shard, kShardCount> shards;
+};
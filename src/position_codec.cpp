@@ -0,0 +1,132 @@
+#include "position_codec.h"
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+bool isContinuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// 首字节之后的 UTF-16 单元数：四字节序列对应代理对
+int unitsOf(unsigned char lead) {
+    return lead >= 0xF0 ? 2 : 1;
+}
+
+size_t sequenceLength(unsigned char lead) {
+    return lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+}
+
+} // namespace
+
+void PositionCodec::findNewlines(const char* data, size_t length, std::vector<uint32_t>& offsets) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 掩码中每个置位对应一个换行符，逐位取出
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (i + 16 <= length) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+        while (mask != 0) {
+            offsets.push_back(static_cast<uint32_t>(i + static_cast<size_t>(__builtin_ctz(mask))));
+            mask &= mask - 1;
+        }
+        i += 16;
+    }
+#endif
+    for (; i < length; ++i) {
+        if (data[i] == '\n') {
+            offsets.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+size_t PositionCodec::utf16Length(const char* data, size_t length) {
+    size_t units = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 每个非延续字节计一个单元，四字节首字节（0xF0 以上）再加一个
+    const __m128i continuationLimit = _mm_set1_epi8(static_cast<char>(0xC0));
+    const __m128i fourByteLimit = _mm_set1_epi8(static_cast<char>(0xEF));
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= length) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned ascii = static_cast<unsigned>(_mm_movemask_epi8(block));
+        if (ascii == 0) {
+            units += 16;
+        } else {
+            __m128i continuation = _mm_cmplt_epi8(block, continuationLimit);
+            __m128i fourByte = _mm_and_si128(_mm_cmpgt_epi8(block, fourByteLimit), _mm_cmplt_epi8(block, zero));
+            units += 16 - static_cast<size_t>(__builtin_popcount(_mm_movemask_epi8(continuation))) +
+                     static_cast<size_t>(__builtin_popcount(_mm_movemask_epi8(fourByte)));
+        }
+        i += 16;
+    }
+#endif
+    for (; i < length; ++i) {
+        if (!isContinuation(data[i])) {
+            units += static_cast<size_t>(unitsOf(static_cast<unsigned char>(data[i])));
+        }
+    }
+    return units;
+}
+
+int PositionCodec::columnOf(const char* data, size_t length, PositionEncoding encoding) {
+    if (encoding == PositionEncoding::Utf8) {
+        return static_cast<int>(length);
+    }
+    return static_cast<int>(utf16Length(data, length));
+}
+
+size_t PositionCodec::offsetOf(const char* data, size_t length, int column, PositionEncoding encoding) {
+    if (column <= 0) {
+        return 0;
+    }
+    size_t target = static_cast<size_t>(column);
+    if (encoding == PositionEncoding::Utf8) {
+        // 列号落在字符中间时退回到字符开头
+        size_t offset = std::min(target, length);
+        while (offset > 0 && offset < length && isContinuation(data[offset])) {
+            --offset;
+        }
+        return offset;
+    }
+
+    size_t units = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 纯 ASCII 块中字节数等于单元数，可以整块跳过
+    while (i + 16 <= length && units + 16 <= target) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(block) != 0) {
+            break;
+        }
+        units += 16;
+        i += 16;
+    }
+#endif
+    while (i < length && units < target) {
+        unsigned char lead = static_cast<unsigned char>(data[i]);
+        units += static_cast<size_t>(unitsOf(lead));
+        i = std::min(length, i + sequenceLength(lead));
+    }
+    return i;
+}
+
+bool PositionCodec::parse(std::string_view name, PositionEncoding& encoding) {
+    if (name == "utf-8") {
+        encoding = PositionEncoding::Utf8;
+        return true;
+    }
+    if (name == "utf-16") {
+        encoding = PositionEncoding::Utf16;
+        return true;
+    }
+    return false;
+}
+
+const char* PositionCodec::name(PositionEncoding encoding) {
+    return encoding == PositionEncoding::Utf8 ? "utf-8" : "utf-16";
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// LSP 位置编码，即列号的计数单位
+enum class PositionEncoding {
+    Utf8,
+    Utf16
+};
+
+// UTF-8 文本与 LSP 列号之间的转换
+// 按 16 字节块用 SSE2 统计换行符和 UTF-16 单元，纯 ASCII 块整块跳过
+class PositionCodec {
+public:
+    // 把每个换行符的偏移追加到 offsets
+    static void findNewlines(const char* data, size_t length, std::vector<uint32_t>& offsets);
+
+    // 一行中前 length 字节对应的列号
+    static int columnOf(const char* data, size_t length, PositionEncoding encoding);
+
+    // 列号对应的字节偏移，超出行长度时返回 length，不会停在字符中间
+    static size_t offsetOf(const char* data, size_t length, int column, PositionEncoding encoding);
+
+    // 协议中的编码名，不支持的名称返回 false
+    static bool parse(std::string_view name, PositionEncoding& encoding);
+    static const char* name(PositionEncoding encoding);
+
+    // 前 length 字节的 UTF-16 单元数
+    static size_t utf16Length(const char* data, size_t length);
+};
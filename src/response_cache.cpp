@@ -0,0 +1,106 @@
+#include "response_cache.h"
+
+ResponseCache::ResponseCache(size_t capacity) : capacity(capacity), nextToken(1) {}
+
+ResponseCache::Lookup ResponseCache::acquire(const std::string& method, const std::string& uri,
+                                             int line, int character) {
+    Lookup lookup;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto version = versions.find(uri);
+    if (version == versions.end() || capacity == 0) {
+        // 未打开的文档可能在磁盘上被修改，不缓存
+        lookup.promise = std::make_shared<std::promise<json>>();
+        lookup.result = lookup.promise->get_future().share();
+        return lookup;
+    }
+
+    lookup.key = method + '\n' + uri + '\n' + std::to_string(version->second) + ':' +
+                 std::to_string(line) + ':' + std::to_string(character);
+
+    auto it = index.find(lookup.key);
+    if (it != index.end()) {
+        // 命中已完成或进行中的请求，移到表头
+        entries.splice(entries.begin(), entries, it->second);
+        lookup.result = it->second->result;
+        return lookup;
+    }
+
+    lookup.promise = std::make_shared<std::promise<json>>();
+    lookup.result = lookup.promise->get_future().share();
+    lookup.token = nextToken++;
+
+    entries.push_front(Entry{lookup.key, uri, lookup.result, lookup.token});
+    index.emplace(lookup.key, entries.begin());
+    keysByUri[uri].insert(lookup.key);
+
+    while (entries.size() > capacity) {
+        eraseEntry(std::prev(entries.end()));
+    }
+    return lookup;
+}
+
+void ResponseCache::complete(const Lookup& lookup, const json& response) {
+    bool cacheable = response.contains("result") && !response.contains("error");
+    if (!cacheable && !lookup.key.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(lookup.key);
+        // 条目可能已被淘汰或失效后重新登记，只删除自己登记的那一个
+        if (it != index.end() && it->second->token == lookup.token) {
+            eraseEntry(it->second);
+        }
+    }
+    lookup.promise->set_value(response);
+}
+
+void ResponseCache::setVersion(const std::string& uri, int version) {
+    std::lock_guard<std::mutex> lock(mutex);
+    versions[uri] = version;
+    invalidateLocked(uri);
+}
+
+void ResponseCache::invalidate(const std::string& uri) {
+    std::lock_guard<std::mutex> lock(mutex);
+    invalidateLocked(uri);
+}
+
+void ResponseCache::close(const std::string& uri) {
+    std::lock_guard<std::mutex> lock(mutex);
+    versions.erase(uri);
+    invalidateLocked(uri);
+}
+
+void ResponseCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    keysByUri.clear();
+    versions.clear();
+}
+
+void ResponseCache::eraseEntry(EntryList::iterator it) {
+    auto keys = keysByUri.find(it->uri);
+    if (keys != keysByUri.end()) {
+        keys->second.erase(it->key);
+        if (keys->second.empty()) {
+            keysByUri.erase(keys);
+        }
+    }
+    index.erase(it->key);
+    entries.erase(it);
+}
+
+void ResponseCache::invalidateLocked(const std::string& uri) {
+    auto keys = keysByUri.find(uri);
+    if (keys == keysByUri.end()) {
+        return;
+    }
+    for (const std::string& key : keys->second) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.erase(it->second);
+            index.erase(it);
+        }
+    }
+    keysByUri.erase(keys);
+}
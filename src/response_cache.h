@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// 位置请求的响应缓存
+// 以 (方法, URI, 文档版本, 行, 列) 为键，容量有限，按最近最少使用淘汰。
+// 相同的请求在响应到达前只发送一次，后来者共享同一个 future。
+// 只缓存已知版本的文档，版本变化或保存时精确清除该文档的条目
+class ResponseCache {
+public:
+    // 一次查找的结果；promise 非空表示调用方负责发送请求，并在收到响应后调用 complete
+    struct Lookup {
+        std::shared_future<json> result;
+        std::shared_ptr<std::promise<json>> promise;
+        std::string key;   // 为空表示不缓存
+        uint64_t token = 0;
+    };
+
+    explicit ResponseCache(size_t capacity = 512);
+
+    Lookup acquire(const std::string& method, const std::string& uri, int line, int character);
+
+    // 交付响应；成功的响应留在缓存中，失败的响应只交给已在等待的调用方
+    void complete(const Lookup& lookup, const json& response);
+
+    // 文档版本变化，清除该文档的全部条目
+    void setVersion(const std::string& uri, int version);
+
+    // 清除文档的全部条目，版本不变
+    void invalidate(const std::string& uri);
+
+    // 文档关闭，清除条目并丢弃版本，之后该文档的响应不再缓存
+    void close(const std::string& uri);
+
+    void clear();
+
+private:
+    struct Entry {
+        std::string key;
+        std::string uri;
+        std::shared_future<json> result;
+        uint64_t token;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    // 调用方持有 mutex
+    void eraseEntry(EntryList::iterator it);
+    void invalidateLocked(const std::string& uri);
+
+    size_t capacity;
+    std::mutex mutex;
+    uint64_t nextToken;
+    EntryList entries;  // 表头为最近使用
+    std::unordered_map<std::string, EntryList::iterator> index;
+    std::unordered_map<std::string, std::unordered_set<std::string>> keysByUri;
+    std::unordered_map<std::string, int> versions;
+};
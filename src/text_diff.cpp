@@ -0,0 +1,194 @@
+#include "text_diff.h"
+#include <algorithm>
+#include <functional>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// 按行切分后的片段，每行包含结尾的换行符
+struct Line {
+    size_t offset;
+    size_t length;
+    size_t hash;
+};
+
+std::vector<Line> splitLines(std::string_view text) {
+    std::vector<Line> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        end = end == std::string_view::npos ? text.size() : end + 1;
+        lines.push_back({start, end - start, std::hash<std::string_view>()(text.substr(start, end - start))});
+        start = end;
+    }
+    return lines;
+}
+
+bool isContinuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// 偏移落在 UTF-8 字符中间或 \r\n 之间时不是合法的编辑边界
+bool isBoundary(std::string_view text, size_t offset) {
+    if (offset == 0 || offset >= text.size()) {
+        return true;
+    }
+    return !isContinuation(text[offset]) && !(text[offset - 1] == '\r' && text[offset] == '\n');
+}
+
+} // namespace
+
+size_t TextDiff::commonPrefix(std::string_view a, std::string_view b) {
+    size_t n = std::min(a.size(), b.size());
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 每次比较 16 字节，第一个不同字节由掩码的最低零位给出
+    while (i + 16 <= n) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        if (mask != 0xFFFF) {
+            return i + static_cast<size_t>(__builtin_ctz(~mask));
+        }
+        i += 16;
+    }
+#endif
+    while (i < n && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+size_t TextDiff::commonSuffix(std::string_view a, std::string_view b, size_t limit) {
+    size_t n = std::min({a.size(), b.size(), limit});
+    const char* aEnd = a.data() + a.size();
+    const char* bEnd = b.data() + b.size();
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 从尾部向前每次比较 16 字节，离尾部最近的不同字节由掩码的最高零位给出
+    while (i + 16 <= n) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(aEnd - i - 16));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bEnd - i - 16));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        if (mask != 0xFFFF) {
+            return i + static_cast<size_t>(__builtin_clz(~mask & 0xFFFF) - 16);
+        }
+        i += 16;
+    }
+#endif
+    while (i < n && aEnd[-1 - static_cast<std::ptrdiff_t>(i)] == bEnd[-1 - static_cast<std::ptrdiff_t>(i)]) {
+        ++i;
+    }
+    return i;
+}
+
+std::vector<TextEdit> TextDiff::diff(std::string_view oldText, std::string_view newText) {
+    std::vector<TextEdit> edits;
+    if (oldText == newText) {
+        return edits;
+    }
+
+    size_t prefix = commonPrefix(oldText, newText);
+    size_t suffix = commonSuffix(oldText, newText, std::min(oldText.size(), newText.size()) - prefix);
+
+    // 边界退回到完整字符处
+    while (prefix > 0 && (!isBoundary(oldText, prefix) || !isBoundary(newText, prefix))) {
+        --prefix;
+    }
+    while (suffix > 0 && (!isBoundary(oldText, oldText.size() - suffix) ||
+                          !isBoundary(newText, newText.size() - suffix))) {
+        --suffix;
+    }
+
+    std::string_view oldMiddle = oldText.substr(prefix, oldText.size() - prefix - suffix);
+    std::string_view newMiddle = newText.substr(prefix, newText.size() - prefix - suffix);
+
+    // 中间部分只有一行时直接替换，否则尝试拆成多处编辑
+    if (oldMiddle.find('\n') == std::string_view::npos || newMiddle.find('\n') == std::string_view::npos ||
+        !diffLines(oldMiddle, newMiddle, prefix, edits)) {
+        edits.clear();
+        edits.push_back({prefix, prefix + oldMiddle.size(), std::string(newMiddle)});
+    }
+    return edits;
+}
+
+bool TextDiff::diffLines(std::string_view oldMiddle, std::string_view newMiddle, size_t base,
+                         std::vector<TextEdit>& edits) {
+    std::vector<Line> a = splitLines(oldMiddle);
+    std::vector<Line> b = splitLines(newMiddle);
+    int n = static_cast<int>(a.size());
+    int m = static_cast<int>(b.size());
+    auto equal = [&](int x, int y) {
+        return a[x].hash == b[y].hash &&
+               oldMiddle.substr(a[x].offset, a[x].length) == newMiddle.substr(b[y].offset, b[y].length);
+    };
+
+    // 正向 Myers：trace[d][k + d] 为第 d 步对角线 k 上走到的最远 x
+    std::vector<std::vector<int>> trace;
+    int found = -1;
+    for (int d = 0; d <= kMaxEditDistance && found < 0; ++d) {
+        std::vector<int> current(2 * d + 1);
+        for (int k = -d; k <= d; k += 2) {
+            int x;
+            if (d == 0) {
+                x = 0;
+            } else {
+                const std::vector<int>& previous = trace[d - 1];
+                bool down = k == -d || (k != d && previous[k - 1 + d - 1] < previous[k + 1 + d - 1]);
+                x = down ? previous[k + 1 + d - 1] : previous[k - 1 + d - 1] + 1;
+            }
+            int y = x - k;
+            while (x < n && y < m && equal(x, y)) {
+                ++x;
+                ++y;
+            }
+            current[k + d] = x;
+            if (x >= n && y >= m) {
+                found = d;
+                break;
+            }
+        }
+        trace.push_back(std::move(current));
+    }
+    if (found < 0) {
+        return false;
+    }
+
+    // 回溯得到逐行的插入和删除，相邻的合并为一处编辑
+    struct Hunk {
+        int oldStart, oldEnd, newStart, newEnd;
+    };
+    std::vector<Hunk> hunks;
+    int x = n;
+    int y = m;
+    for (int d = found; d > 0; --d) {
+        const std::vector<int>& previous = trace[d - 1];
+        int k = x - y;
+        bool down = k == -d || (k != d && previous[k - 1 + d - 1] < previous[k + 1 + d - 1]);
+        int previousK = down ? k + 1 : k - 1;
+        int previousX = previous[previousK + d - 1];
+        int previousY = previousX - previousK;
+
+        Hunk hunk = down ? Hunk{previousX, previousX, previousY, previousY + 1}
+                         : Hunk{previousX, previousX + 1, previousY, previousY};
+        if (!hunks.empty() && hunks.back().oldStart == hunk.oldEnd && hunks.back().newStart == hunk.newEnd) {
+            hunks.back().oldStart = hunk.oldStart;
+            hunks.back().newStart = hunk.newStart;
+        } else {
+            hunks.push_back(hunk);
+        }
+        x = previousX;
+        y = previousY;
+    }
+
+    auto oldOffset = [&](int i) { return i < n ? a[i].offset : oldMiddle.size(); };
+    auto newOffset = [&](int i) { return i < m ? b[i].offset : newMiddle.size(); };
+    for (auto it = hunks.rbegin(); it != hunks.rend(); ++it) {
+        size_t newStart = newOffset(it->newStart);
+        edits.push_back({base + oldOffset(it->oldStart), base + oldOffset(it->oldEnd),
+                         std::string(newMiddle.substr(newStart, newOffset(it->newEnd) - newStart))});
+    }
+    return true;
+}
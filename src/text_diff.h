@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 一处文本替换，start/end 为旧文本中的字节偏移
+struct TextEdit {
+    size_t start;
+    size_t end;
+    std::string text;
+};
+
+// LSP 位置：行号与 UTF-16 列号
+struct TextPosition {
+    int line;
+    int character;
+};
+
+// 增量同步使用的文本差异计算
+// 先用 SIMD 比较去掉公共前缀和后缀，再在中间部分按行做 Myers 差异，
+// 编辑步数超过上限时退化为整段替换
+class TextDiff {
+public:
+    // 计算把 oldText 变为 newText 的编辑，按位置升序且互不重叠，编辑边界不会切开 UTF-8 字符或 \r\n
+    static std::vector<TextEdit> diff(std::string_view oldText, std::string_view newText);
+
+    // 公共前缀的字节数
+    static size_t commonPrefix(std::string_view a, std::string_view b);
+
+    // 公共后缀的字节数，最多比较 limit 个字节
+    static size_t commonSuffix(std::string_view a, std::string_view b, size_t limit);
+
+private:
+    // 行级 Myers 的最大编辑步数
+    static constexpr int kMaxEditDistance = 256;
+
+    // 按行比较去掉前后缀后的中间部分，base 为其在旧文本中的偏移；编辑步数超过上限时返回 false
+    static bool diffLines(std::string_view oldMiddle, std::string_view newMiddle, size_t base,
+                          std::vector<TextEdit>& edits);
+};
@@ -0,0 +1,70 @@
+#include "timer_wheel.h"
+#include <algorithm>
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, size_t slotCount)
+    : tick(tick.count() > 0 ? tick : std::chrono::milliseconds(1)),
+      origin(Clock::now()),
+      currentTick(0),
+      nextId(1),
+      slots(slotCount == 0 ? 1 : slotCount) {}
+
+uint64_t TimerWheel::ticksAt(Clock::time_point time) const {
+    if (time <= origin) {
+        return 0;
+    }
+    return static_cast<uint64_t>((time - origin) / tick);
+}
+
+uint64_t TimerWheel::schedule(std::chrono::milliseconds delay, Callback callback) {
+    // 向上取整到 tick，且至少落在下一个 tick，保证不会提前触发
+    uint64_t ticks = static_cast<uint64_t>((std::max(delay, std::chrono::milliseconds(0)) + tick - std::chrono::milliseconds(1)) / tick);
+    uint64_t deadlineTick = std::max(ticksAt(Clock::now()), currentTick) + std::max<uint64_t>(ticks, 1);
+
+    uint64_t timerId = nextId++;
+    auto& slot = slots[deadlineTick % slots.size()];
+    slot.push_front(Entry{timerId, deadlineTick, std::move(callback)});
+    index.emplace(timerId, slot.begin());
+    return timerId;
+}
+
+bool TimerWheel::cancel(uint64_t timerId) {
+    auto it = index.find(timerId);
+    if (it == index.end()) {
+        return false;
+    }
+    slots[it->second->deadlineTick % slots.size()].erase(it->second);
+    index.erase(it);
+    return true;
+}
+
+std::vector<TimerWheel::Callback> TimerWheel::advance(Clock::time_point now) {
+    std::vector<Callback> expired;
+    uint64_t targetTick = ticksAt(now);
+    if (targetTick <= currentTick) {
+        return expired;
+    }
+
+    // 只扫描经过的槽；落后超过一圈时每个槽扫描一次即可
+    uint64_t steps = std::min<uint64_t>(targetTick - currentTick, slots.size());
+    for (uint64_t step = 1; step <= steps; ++step) {
+        auto& slot = slots[(currentTick + step) % slots.size()];
+        for (auto it = slot.begin(); it != slot.end();) {
+            if (it->deadlineTick <= targetTick) {
+                expired.push_back(std::move(it->callback));
+                index.erase(it->id);
+                it = slot.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    currentTick = targetTick;
+    return expired;
+}
+
+void TimerWheel::clear() {
+    for (auto& slot : slots) {
+        slot.clear();
+    }
+    index.clear();
+}
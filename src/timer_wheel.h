@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// 哈希时间轮
+// 到期时间按 tick 取模散列到槽中，添加、取消都是 O(1)，推进时只扫描经过的槽，
+// 适合大量同时存在、大多会被提前取消的请求超时。本身不加锁，由调用方同步
+class TimerWheel {
+public:
+    using Callback = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(50), size_t slotCount = 512);
+
+    // 添加定时器，返回 ID
+    uint64_t schedule(std::chrono::milliseconds delay, Callback callback);
+
+    // 取消定时器，已到期或不存在时返回 false
+    bool cancel(uint64_t timerId);
+
+    // 推进到 now，返回到期的回调，由调用方在释放锁之后执行
+    std::vector<Callback> advance(Clock::time_point now = Clock::now());
+
+    // 丢弃所有定时器
+    void clear();
+
+    bool empty() const { return index.empty(); }
+
+    size_t size() const { return index.size(); }
+
+    std::chrono::milliseconds getTick() const { return tick; }
+
+private:
+    struct Entry {
+        uint64_t id;
+        uint64_t deadlineTick;
+        Callback callback;
+    };
+
+    uint64_t ticksAt(Clock::time_point time) const;
+
+    std::chrono::milliseconds tick;
+    Clock::time_point origin;
+    uint64_t currentTick;
+    uint64_t nextId;
+    std::vector<std::list<Entry>> slots;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+};
@@ -0,0 +1,387 @@
+#include "transport.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+}
+
+// ---------------- FdTransport ----------------
+
+FdTransport::FdTransport(int inFd, int outFd) : inFd(inFd), outFd(outFd), isSocket(false) {
+    struct stat st;
+    isSocket = fstat(outFd, &st) == 0 && S_ISSOCK(st.st_mode);
+    setNonBlocking(inFd);
+    if (outFd != inFd) {
+        setNonBlocking(outFd);
+    }
+}
+
+FdTransport::~FdTransport() {
+    FdTransport::close();
+}
+
+ssize_t FdTransport::read(void* buffer, size_t length) {
+    ssize_t n;
+    do {
+        n = ::read(inFd, buffer, length);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+ssize_t FdTransport::writev(const struct iovec* iov, int count) {
+    ssize_t n;
+    if (isSocket) {
+        // 对端断开时返回 EPIPE 而不是触发 SIGPIPE 结束进程
+        struct msghdr msg = {};
+        msg.msg_iov = const_cast<struct iovec*>(iov);
+        msg.msg_iovlen = static_cast<size_t>(count);
+        do {
+            n = ::sendmsg(outFd, &msg, MSG_NOSIGNAL);
+        } while (n < 0 && errno == EINTR);
+        return n;
+    }
+    // 管道没有 MSG_NOSIGNAL：写入期间在本线程屏蔽 SIGPIPE，服务器进程退出时返回 EPIPE，
+    // 由读端的 EOF 按连接断开处理；写入产生的 SIGPIPE 在恢复屏蔽字之前取走
+    sigset_t pipeSignal;
+    sigset_t previous;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &previous);
+    sigset_t pending;
+    sigpending(&pending);
+    bool alreadyPending = sigismember(&pending, SIGPIPE) == 1;
+
+    do {
+        n = ::writev(outFd, iov, count);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0 && errno == EPIPE && !alreadyPending) {
+        int savedErrno = errno;
+        struct timespec zero = {0, 0};
+        while (sigtimedwait(&pipeSignal, nullptr, &zero) < 0 && errno == EINTR) {
+        }
+        errno = savedErrno;
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    return n;
+}
+
+void FdTransport::close() {
+    // 先关闭套接字的读写方向，唤醒仍阻塞在 poll 上的其他线程
+    if (isSocket && outFd >= 0) {
+        ::shutdown(outFd, SHUT_RDWR);
+    }
+    if (outFd >= 0 && outFd != inFd) {
+        ::close(outFd);
+    }
+    if (inFd >= 0) {
+        ::close(inFd);
+    }
+    inFd = outFd = -1;
+}
+
+// ---------------- PipeTransport ----------------
+
+PipeTransport::PipeTransport(int inFd, int outFd, pid_t pid) : FdTransport(inFd, outFd), pid(pid) {}
+
+PipeTransport::~PipeTransport() {
+    PipeTransport::close();
+}
+
+std::unique_ptr<PipeTransport> PipeTransport::spawn(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        return nullptr;
+    }
+
+    int stdinPipe[2];  // 用于向子进程写入数据
+    int stdoutPipe[2]; // 用于从子进程读取数据
+    if (pipe2(stdinPipe, O_CLOEXEC) < 0) {
+        std::cerr << "Failed to create pipes" << std::endl;
+        return nullptr;
+    }
+    if (pipe2(stdoutPipe, O_CLOEXEC) < 0) {
+        std::cerr << "Failed to create pipes" << std::endl;
+        ::close(stdinPipe[0]);
+        ::close(stdinPipe[1]);
+        return nullptr;
+    }
+
+    // fork 之前准备好参数，子进程中只调用 async-signal-safe 函数
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "Failed to fork process" << std::endl;
+        ::close(stdinPipe[0]);
+        ::close(stdinPipe[1]);
+        ::close(stdoutPipe[0]);
+        ::close(stdoutPipe[1]);
+        return nullptr;
+    }
+
+    if (pid == 0) {  // 子进程
+        // dup2 得到的 fd 不带 CLOEXEC，其余管道端在 exec 时自动关闭
+        dup2(stdinPipe[0], STDIN_FILENO);
+        dup2(stdoutPipe[1], STDOUT_FILENO);
+        execvp(argv[0], argv.data());
+        perror("Failed to execute server");
+        _exit(1);
+    }
+
+    // 父进程，关闭不需要的管道端
+    ::close(stdinPipe[0]);
+    ::close(stdoutPipe[1]);
+    return std::unique_ptr<PipeTransport>(new PipeTransport(stdoutPipe[0], stdinPipe[1], pid));
+}
+
+void PipeTransport::close() {
+    // 关闭子进程的标准输入后等待其自行退出，超时则强制结束，保证回收不留僵尸进程
+    FdTransport::close();
+    if (pid <= 0) {
+        return;
+    }
+    for (int waited = 0; waited < kExitTimeoutMs; waited += 10) {
+        pid_t result = waitpid(pid, nullptr, WNOHANG);
+        if (result == pid || (result < 0 && errno != EINTR)) {
+            pid = -1;
+            return;
+        }
+        usleep(10 * 1000);
+    }
+    kill(pid, SIGKILL);
+    while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR) {
+    }
+    pid = -1;
+}
+
+// ---------------- TcpTransport ----------------
+
+TcpTransport::TcpTransport(int sock) : FdTransport(sock, sock) {}
+
+std::unique_ptr<TcpTransport> TcpTransport::connect(const std::string& host, int port) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    // 解析主机名或IP地址
+    struct addrinfo* result = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0 || !result) {
+        std::cerr << "无法解析服务器地址: " << host << std::endl;
+        return nullptr;
+    }
+
+    int sock = -1;
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (sock < 0) {
+            continue;
+        }
+        if (::connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        ::close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(result);
+
+    if (sock < 0) {
+        std::cerr << "连接服务器失败: " << host << ":" << port << std::endl;
+        return nullptr;
+    }
+
+    // 消息头与消息体已经合并写出，关闭 Nagle 避免小请求被延迟
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return std::unique_ptr<TcpTransport>(new TcpTransport(sock));
+}
+
+// ---------------- UnixSocketTransport ----------------
+
+UnixSocketTransport::UnixSocketTransport(int sock, const PeerCredentials& peer) : FdTransport(sock, sock), peer(peer) {}
+
+socklen_t UnixSocketTransport::makeAddress(const std::string& path, struct sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        return 0;
+    }
+
+    if (path[0] == '@') {
+        // 抽象命名空间：sun_path[0] 为 '\0'，地址长度不含结尾的 NUL
+        if (path.size() == 1) {
+            return 0;
+        }
+        memcpy(addr.sun_path + 1, path.data() + 1, path.size() - 1);
+        return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path.size());
+    }
+
+    memcpy(addr.sun_path, path.data(), path.size());
+    return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path.size() + 1);
+}
+
+std::unique_ptr<UnixSocketTransport> UnixSocketTransport::connect(const std::string& path) {
+    struct sockaddr_un addr;
+    socklen_t addrLength = makeAddress(path, addr);
+    if (addrLength == 0) {
+        std::cerr << "无效的Unix套接字路径: " << path << std::endl;
+        return nullptr;
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        std::cerr << "创建socket失败" << std::endl;
+        return nullptr;
+    }
+    if (::connect(sock, reinterpret_cast<struct sockaddr*>(&addr), addrLength) < 0) {
+        std::cerr << "连接服务器失败: " << path << std::endl;
+        ::close(sock);
+        return nullptr;
+    }
+
+    // 读取对端凭据，供调用方校验服务器身份
+    struct ucred cred = {};
+    socklen_t credLength = sizeof(cred);
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &credLength) < 0) {
+        std::cerr << "读取对端凭据失败: " << path << std::endl;
+        ::close(sock);
+        return nullptr;
+    }
+
+    PeerCredentials peer = {cred.pid, cred.uid, cred.gid};
+    return std::unique_ptr<UnixSocketTransport>(new UnixSocketTransport(sock, peer));
+}
+
+// ---------------- LoopbackTransport ----------------
+
+LoopbackTransport::Channel::Channel()
+    : readPos(0), closed(false), eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+LoopbackTransport::Channel::~Channel() {
+    if (eventFd >= 0) {
+        ::close(eventFd);
+    }
+}
+
+LoopbackTransport::LoopbackTransport(std::shared_ptr<Channel> in, std::shared_ptr<Channel> out)
+    : in(std::move(in)), out(std::move(out)), open(true) {}
+
+LoopbackTransport::~LoopbackTransport() {
+    close();
+}
+
+std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>> LoopbackTransport::createPair() {
+    auto forward = std::make_shared<Channel>();
+    auto backward = std::make_shared<Channel>();
+    return {std::unique_ptr<LoopbackTransport>(new LoopbackTransport(backward, forward)),
+            std::unique_ptr<LoopbackTransport>(new LoopbackTransport(forward, backward))};
+}
+
+ssize_t LoopbackTransport::read(void* buffer, size_t length) {
+    if (!open) {
+        errno = EBADF;
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(in->mutex);
+    size_t available = in->data.size() - in->readPos;
+    if (available == 0) {
+        if (in->closed) {
+            return 0;
+        }
+        errno = EAGAIN;
+        return -1;
+    }
+
+    size_t n = std::min(available, length);
+    memcpy(buffer, in->data.data() + in->readPos, n);
+    in->readPos += n;
+
+    // 读空后复位缓冲区并清除就绪状态
+    if (in->readPos == in->data.size()) {
+        in->data.clear();
+        in->readPos = 0;
+        if (!in->closed) {
+            uint64_t value;
+            ssize_t r = ::read(in->eventFd, &value, sizeof(value));
+            (void)r;
+        }
+    }
+    return static_cast<ssize_t>(n);
+}
+
+ssize_t LoopbackTransport::writev(const struct iovec* iov, int count) {
+    if (!open) {
+        errno = EBADF;
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(out->mutex);
+    if (out->closed) {
+        errno = EPIPE;
+        return -1;
+    }
+
+    bool wasEmpty = out->data.size() == out->readPos;
+    size_t total = 0;
+    for (int i = 0; i < count; ++i) {
+        const char* base = static_cast<const char*>(iov[i].iov_base);
+        out->data.insert(out->data.end(), base, base + iov[i].iov_len);
+        total += iov[i].iov_len;
+    }
+
+    if (wasEmpty && total > 0) {
+        uint64_t one = 1;
+        ssize_t r = ::write(out->eventFd, &one, sizeof(one));
+        (void)r;
+    }
+    return static_cast<ssize_t>(total);
+}
+
+int LoopbackTransport::readFd() const {
+    return in->eventFd;
+}
+
+int LoopbackTransport::writeFd() const {
+    // 内存缓冲区不限长度，eventfd 总是可写
+    return out->eventFd;
+}
+
+void LoopbackTransport::close() {
+    if (!open) {
+        return;
+    }
+    open = false;
+
+    // 通知对端读到 EOF
+    uint64_t one = 1;
+    for (Channel* channel : {in.get(), out.get()}) {
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        channel->closed = true;
+        ssize_t r = ::write(channel->eventFd, &one, sizeof(one));
+        (void)r;
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+struct iovec;
+
+// 对端进程凭据，来自 SO_PEERCRED
+struct PeerCredentials {
+    pid_t pid;
+    uid_t uid;
+    gid_t gid;
+};
+
+// 客户端与服务器之间的字节流传输层
+// 所有实现都是非阻塞的：暂时无法读写时返回 -1 并将 errno 置为 EAGAIN，
+// 调用方通过 readFd/writeFd 在 epoll/poll 上等待就绪
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    // 语义同 read：返回读取字节数，0 表示对端关闭
+    virtual ssize_t read(void* buffer, size_t length) = 0;
+
+    // 语义同 writev：返回写入字节数，可能只写出一部分
+    virtual ssize_t writev(const struct iovec* iov, int count) = 0;
+
+    // 有数据可读时就绪的 fd
+    virtual int readFd() const = 0;
+
+    // 可以写入时就绪的 fd
+    virtual int writeFd() const = 0;
+
+    // 关闭传输，之后的读写都会失败
+    virtual void close() = 0;
+
+    virtual bool isOpen() const = 0;
+};
+
+// 基于文件描述符的传输，socket 的读写端是同一个 fd
+class FdTransport : public Transport {
+public:
+    FdTransport(int inFd, int outFd);
+    ~FdTransport() override;
+
+    ssize_t read(void* buffer, size_t length) override;
+    ssize_t writev(const struct iovec* iov, int count) override;
+    int readFd() const override { return inFd; }
+    int writeFd() const override { return outFd; }
+    void close() override;
+    bool isOpen() const override { return inFd >= 0; }
+
+protected:
+    int inFd;
+    int outFd;
+    bool isSocket;  // 套接字用 MSG_NOSIGNAL，管道在写入期间屏蔽 SIGPIPE
+};
+
+// 子进程标准输入输出管道
+class PipeTransport : public FdTransport {
+public:
+    // 启动子进程，args[0] 为可执行文件名，按 PATH 查找
+    static std::unique_ptr<PipeTransport> spawn(const std::vector<std::string>& args);
+
+    ~PipeTransport() override;
+
+    pid_t getPid() const { return pid; }
+
+    void close() override;
+
+private:
+    PipeTransport(int inFd, int outFd, pid_t pid);
+
+    // close 时等待子进程退出的时间，超时后 SIGKILL
+    static constexpr int kExitTimeoutMs = 2000;
+
+    pid_t pid;
+};
+
+// TCP 连接
+class TcpTransport : public FdTransport {
+public:
+    static std::unique_ptr<TcpTransport> connect(const std::string& host, int port);
+
+private:
+    explicit TcpTransport(int sock);
+};
+
+// Unix 域套接字连接
+// 以 '@' 开头的路径表示 Linux 抽象命名空间地址，不在文件系统中创建节点
+class UnixSocketTransport : public FdTransport {
+public:
+    static std::unique_ptr<UnixSocketTransport> connect(const std::string& path);
+
+    // 填充 sockaddr_un，返回地址长度，路径非法时返回 0
+    static socklen_t makeAddress(const std::string& path, struct sockaddr_un& addr);
+
+    // 连接建立时读取的对端凭据
+    const PeerCredentials& getPeerCredentials() const { return peer; }
+
+private:
+    UnixSocketTransport(int sock, const PeerCredentials& peer);
+
+    PeerCredentials peer;
+};
+
+// 进程内回环传输
+// 一对实例互为两端，数据只在共享的内存缓冲区之间移动，
+// 读就绪通过 eventfd 通知，缓冲区由空变非空时才会触发
+class LoopbackTransport : public Transport {
+public:
+    static std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>> createPair();
+
+    ~LoopbackTransport() override;
+
+    ssize_t read(void* buffer, size_t length) override;
+    ssize_t writev(const struct iovec* iov, int count) override;
+    int readFd() const override;
+    int writeFd() const override;
+    void close() override;
+    bool isOpen() const override { return open; }
+
+private:
+    // 单向通道
+    struct Channel {
+        Channel();
+        ~Channel();
+
+        std::mutex mutex;
+        std::vector<char> data;
+        size_t readPos;
+        bool closed;
+        int eventFd;
+    };
+
+    LoopbackTransport(std::shared_ptr<Channel> in, std::shared_ptr<Channel> out);
+
+    std::shared_ptr<Channel> in;
+    std::shared_ptr<Channel> out;
+    bool open;
+};
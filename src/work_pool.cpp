@@ -0,0 +1,142 @@
+#include "work_pool.h"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+namespace {
+// 当前线程所属的线程池与工作队列，用于就地提交
+thread_local const WorkPool* currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+}
+
+WorkPool::WorkPool(size_t threadCount) : nextWorker(0), queued(0), stopping(false) {
+    if (threadCount == 0) {
+        threadCount = std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 4);
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back([this, i]() { run(i); });
+    }
+}
+
+WorkPool::~WorkPool() {
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    idleCondition.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkPool::submit(Task task) {
+    push(std::move(task));
+}
+
+void WorkPool::submit(const std::string& key, Task task) {
+    Strand& strand = strands[std::hash<std::string>()(key) % kStrandCount];
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(strand.mutex);
+        strand.tasks.push_back(std::move(task));
+        if (!strand.scheduled) {
+            strand.scheduled = true;
+            schedule = true;
+        }
+    }
+    if (schedule) {
+        push([this, &strand]() { drainStrand(strand); });
+    }
+}
+
+void WorkPool::push(Task task) {
+    // 工作线程提交到自己的队列，外部线程轮流分配
+    size_t index = currentPool == this ? currentWorker
+                                       : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    {
+        // 与等待方的谓词检查串行化，避免丢失唤醒
+        std::lock_guard<std::mutex> lock(idleMutex);
+    }
+    idleCondition.notify_one();
+}
+
+bool WorkPool::popLocal(size_t index, Task& task) {
+    Worker& worker = *workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool WorkPool::steal(size_t thief, Task& task) {
+    for (size_t offset = 1; offset < workers.size(); ++offset) {
+        Worker& victim = *workers[(thief + offset) % workers.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks.empty()) {
+            continue;
+        }
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void WorkPool::run(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+
+    while (true) {
+        Task task;
+        if (popLocal(index, task) || steal(index, task)) {
+            queued.fetch_sub(1, std::memory_order_acq_rel);
+            try {
+                task();
+            } catch (const std::exception& e) {
+                std::cerr << "处理任务时出错: " << e.what() << std::endl;
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex);
+        idleCondition.wait(lock, [this]() {
+            return stopping || queued.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping && queued.load(std::memory_order_acquire) <= 0) {
+            return;
+        }
+    }
+}
+
+void WorkPool::drainStrand(Strand& strand) {
+    for (int i = 0; i < kStrandBatch; ++i) {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(strand.mutex);
+            if (strand.tasks.empty()) {
+                strand.scheduled = false;
+                return;
+            }
+            task = std::move(strand.tasks.front());
+            strand.tasks.pop_front();
+        }
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "处理任务时出错: " << e.what() << std::endl;
+        }
+    }
+    // 还有剩余任务，重新排队，避免一个繁忙的 key 长期占用线程
+    push([this, &strand]() { drainStrand(strand); });
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 工作窃取线程池
+// 每个工作线程有自己的双端队列：本线程从队尾取任务，空闲线程从其他队列队首窃取。
+// 带 key 的任务进入按 key 哈希的串行队列（strand），同一 key 的任务严格按提交顺序执行，
+// 不同 key 的任务可在多个线程上并行
+class WorkPool {
+public:
+    using Task = std::function<void()>;
+
+    // threadCount 为 0 时按 CPU 核数选择，至少 2 个、至多 4 个线程
+    explicit WorkPool(size_t threadCount = 0);
+
+    // 执行完已提交的任务后退出
+    ~WorkPool();
+
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+
+    // 提交任务，不保证顺序
+    void submit(Task task);
+
+    // 提交任务，key 相同的任务按提交顺序串行执行
+    void submit(const std::string& key, Task task);
+
+    size_t threadCount() const { return threads.size(); }
+
+private:
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct alignas(64) Strand {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        bool scheduled = false;  // 是否已有排空任务在池中
+    };
+
+    static constexpr size_t kStrandCount = 64;
+
+    // strand 每次最多连续执行的任务数，之后重新排队让出线程
+    static constexpr int kStrandBatch = 16;
+
+    void push(Task task);
+    bool popLocal(size_t index, Task& task);
+    bool steal(size_t thief, Task& task);
+    void run(size_t index);
+    void drainStrand(Strand& strand);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::array<Strand, kStrandCount> strands;
+
+    std::atomic<size_t> nextWorker;
+    std::atomic<long> queued;  // 所有工作队列中的任务数
+
+    std::mutex idleMutex;
+    std::condition_variable idleCondition;
+    bool stopping;
+};
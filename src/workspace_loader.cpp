@@ -0,0 +1,125 @@
+#include "workspace_loader.h"
+#include "file_utils.h"
+#include "file_view.h"
+#include "lsp_client.h"
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+double WorkspaceLoader::Stats::filesPerSecond() const {
+    return elapsed.count() > 0 ? files * 1000.0 / elapsed.count() : 0.0;
+}
+
+double WorkspaceLoader::Stats::megabytesPerSecond() const {
+    return elapsed.count() > 0 ? bytes / (1024.0 * 1024.0) * 1000.0 / elapsed.count() : 0.0;
+}
+
+WorkspaceLoader::WorkspaceLoader(LSPClient& client, size_t threadCount)
+    : client(client), pool(threadCount), files(0), bytes(0), failed(0), outstanding(0) {}
+
+WorkspaceLoader::Stats WorkspaceLoader::open(const std::vector<std::string>& roots,
+                                             const std::vector<std::string>& extensions,
+                                             const std::string& languageId) {
+    this->extensions = extensions;
+    auto start = begin(languageId);
+    for (const std::string& root : roots) {
+        // 相对路径先转为绝对路径，否则生成的 URI 会变成 file:///src/...
+        std::error_code error;
+        std::string path = fs::absolute(root, error).lexically_normal().string();
+        submit([this, path]() { scanDirectory(path); });
+    }
+    return finish(start);
+}
+
+WorkspaceLoader::Stats WorkspaceLoader::openFiles(const std::vector<std::string>& paths,
+                                                  const std::string& languageId) {
+    auto start = begin(languageId);
+    for (const std::string& path : paths) {
+        submit([this, path]() { openFile(path); });
+    }
+    return finish(start);
+}
+
+std::chrono::steady_clock::time_point WorkspaceLoader::begin(const std::string& languageId) {
+    this->languageId = languageId;
+    files = 0;
+    bytes = 0;
+    failed = 0;
+    return std::chrono::steady_clock::now();
+}
+
+WorkspaceLoader::Stats WorkspaceLoader::finish(std::chrono::steady_clock::time_point start) {
+    {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [this]() { return outstanding == 0; });
+    }
+
+    Stats stats;
+    stats.files = files;
+    stats.bytes = bytes;
+    stats.failed = failed;
+    stats.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    return stats;
+}
+
+void WorkspaceLoader::submit(WorkPool::Task task) {
+    {
+        std::lock_guard<std::mutex> lock(doneMutex);
+        ++outstanding;
+    }
+    pool.submit([this, task = std::move(task)]() {
+        // 任务抛出异常时同样要计数，否则 finish 会一直等待
+        struct Done {
+            WorkspaceLoader* loader;
+            ~Done() {
+                std::lock_guard<std::mutex> lock(loader->doneMutex);
+                if (--loader->outstanding == 0) {
+                    loader->doneCondition.notify_all();
+                }
+            }
+        } done{this};
+        task();
+    });
+}
+
+void WorkspaceLoader::scanDirectory(const std::string& path) {
+    std::error_code error;
+    fs::directory_iterator it(path, fs::directory_options::skip_permission_denied, error);
+    if (error) {
+        std::cerr << "无法遍历目录: " << path << " (" << error.message() << ")" << std::endl;
+        return;
+    }
+    for (; it != fs::directory_iterator(); it.increment(error)) {
+        if (error) {
+            std::cerr << "遍历目录出错: " << path << " (" << error.message() << ")" << std::endl;
+            return;
+        }
+        const fs::directory_entry& entry = *it;
+        std::string name = entry.path().filename().string();
+        fs::file_status status = entry.symlink_status(error);
+        if (error || name.empty() || name[0] == '.') {
+            continue;
+        }
+        // 子目录和文件都作为新任务提交，由空闲线程窃取并行处理
+        std::string child = entry.path().string();
+        if (fs::is_directory(status)) {
+            submit([this, child]() { scanDirectory(child); });
+        } else if (fs::is_regular_file(status) && FileUtils::hasExtension(child, extensions)) {
+            submit([this, child]() { openFile(child); });
+        }
+    }
+}
+
+void WorkspaceLoader::openFile(const std::string& path) {
+    // 映射的内容直接交给 openDocument，只在写入文档存储时复制一次
+    FileView content;
+    if (!content.open(path)) {
+        ++failed;
+        return;
+    }
+    client.openDocument(FileUtils::pathToUri(path), content.view(), languageId);
+    ++files;
+    bytes += content.size();
+}
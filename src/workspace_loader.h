@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "work_pool.h"
+
+class LSPClient;
+
+// 批量打开工作区中的源文件
+// 目录遍历和文件读取都作为任务提交到有界线程池，每读完一个文件立即发送 didOpen，
+// 发送由出站调度器的批量上限限流，写不出去时读取线程随之阻塞，内存占用有上界
+class WorkspaceLoader {
+public:
+    // 一次批量打开的统计
+    struct Stats {
+        size_t files = 0;
+        size_t bytes = 0;
+        size_t failed = 0;
+        std::chrono::milliseconds elapsed{0};
+
+        double filesPerSecond() const;
+        double megabytesPerSecond() const;
+    };
+
+    // threadCount 为 0 时按 CPU 核数选择
+    explicit WorkspaceLoader(LSPClient& client, size_t threadCount = 0);
+
+    // 打开 roots 下所有扩展名在 extensions 中的文件，跳过隐藏目录和符号链接目录，返回时全部 didOpen 已排队
+    Stats open(const std::vector<std::string>& roots, const std::vector<std::string>& extensions,
+               const std::string& languageId);
+
+    // 打开给定的文件列表，读取和发送方式与 open 相同
+    Stats openFiles(const std::vector<std::string>& paths, const std::string& languageId);
+
+private:
+    // 重置统计并开始计时；等待所有任务结束后汇总统计
+    std::chrono::steady_clock::time_point begin(const std::string& languageId);
+    Stats finish(std::chrono::steady_clock::time_point start);
+
+    void scanDirectory(const std::string& path);
+    void openFile(const std::string& path);
+
+    // 提交任务并计入未完成数，任务结束时减一
+    void submit(WorkPool::Task task);
+
+    LSPClient& client;
+    WorkPool pool;
+
+    // 当前一次 open 的参数与统计
+    std::vector<std::string> extensions;
+    std::string languageId;
+    std::atomic<size_t> files;
+    std::atomic<size_t> bytes;
+    std::atomic<size_t> failed;
+
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    long outstanding;
+};
@@ -0,0 +1,310 @@
+#include "workspace_snapshot.h"
+#include "file_utils.h"
+#include "file_view.h"
+#include "work_pool.h"
+#include "xxhash64.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int kFormatVersion = 1;
+
+// 需要重新计算哈希的文件
+struct HashJob {
+    std::string path;
+    WorkspaceSnapshot::Node* parent;
+    std::string name;
+    bool failed;  // 读取失败，节点在哈希结束后删除
+};
+
+using Node = WorkspaceSnapshot::Node;
+
+const Node* findChild(const Node* parent, const std::string& name) {
+    if (!parent || !parent->directory) {
+        return nullptr;
+    }
+    auto it = parent->children.find(name);
+    return it != parent->children.end() ? &it->second : nullptr;
+}
+
+// 遍历目录，建立节点；大小和修改时间与旧快照一致的文件直接沿用旧哈希
+void crawl(const std::string& path, Node& node, const Node* previous, const std::vector<std::string>& extensions,
+           std::vector<HashJob>& jobs) {
+    std::error_code error;
+    fs::directory_iterator it(path, fs::directory_options::skip_permission_denied, error);
+    if (error) {
+        std::cerr << "无法遍历目录: " << path << " (" << error.message() << ")" << std::endl;
+        return;
+    }
+    for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+        std::string name = it->path().filename().string();
+        fs::file_status status = it->symlink_status(error);
+        if (error || name.empty() || name[0] == '.') {
+            continue;
+        }
+        std::string child = it->path().string();
+        if (fs::is_directory(status)) {
+            Node& directory = node.children[name];
+            directory.directory = true;
+            crawl(child, directory, findChild(previous, name), extensions, jobs);
+        } else if (fs::is_regular_file(status) && FileUtils::hasExtension(child, extensions)) {
+            Node& file = node.children[name];
+            file.size = it->file_size(error);
+            auto modified = it->last_write_time(error);
+            file.modified = std::chrono::duration_cast<std::chrono::nanoseconds>(modified.time_since_epoch()).count();
+
+            const Node* old = findChild(previous, name);
+            if (old && !old->directory && old->size == file.size && old->modified == file.modified) {
+                file.hash = old->hash;
+            } else {
+                jobs.push_back({child, &node, name, false});
+            }
+        }
+    }
+}
+
+void tally(const Node& node, size_t& files, uint64_t& bytes) {
+    if (!node.directory) {
+        ++files;
+        bytes += node.size;
+        return;
+    }
+    for (const auto& entry : node.children) {
+        tally(entry.second, files, bytes);
+    }
+}
+
+// 自底向上计算目录哈希，去掉不含匹配文件的目录
+void finalize(Node& node, size_t& files, uint64_t& bytes) {
+    std::string entries;
+    for (auto it = node.children.begin(); it != node.children.end();) {
+        Node& child = it->second;
+        if (child.directory) {
+            finalize(child, files, bytes);
+            if (child.children.empty()) {
+                it = node.children.erase(it);
+                continue;
+            }
+        } else {
+            tally(child, files, bytes);
+        }
+        // 名称、类型和子哈希依次写入，名称以 \0 结尾避免拼接歧义
+        entries.append(it->first);
+        entries.push_back('\0');
+        entries.push_back(child.directory ? 'd' : 'f');
+        entries.append(reinterpret_cast<const char*>(&child.hash), sizeof(child.hash));
+        ++it;
+    }
+    node.hash = XXHash64::hash(entries.data(), entries.size());
+}
+
+json toJson(const Node& node) {
+    if (!node.directory) {
+        return {{"h", node.hash}, {"s", node.size}, {"m", node.modified}};
+    }
+    json children = json::object();
+    for (const auto& [name, child] : node.children) {
+        children[name] = toJson(child);
+    }
+    return {{"h", node.hash}, {"d", std::move(children)}};
+}
+
+Node fromJson(const json& value) {
+    Node node;
+    node.hash = value.at("h").get<uint64_t>();
+    auto children = value.find("d");
+    if (children != value.end()) {
+        node.directory = true;
+        for (auto it = children->begin(); it != children->end(); ++it) {
+            node.children.emplace(it.key(), fromJson(it.value()));
+        }
+    } else {
+        node.size = value.at("s").get<uint64_t>();
+        node.modified = value.at("m").get<int64_t>();
+    }
+    return node;
+}
+
+void collect(const Node& node, const std::string& path, FileChangeType type, std::vector<FileChange>& changes) {
+    if (!node.directory) {
+        changes.push_back({path, type});
+        return;
+    }
+    for (const auto& [name, child] : node.children) {
+        collect(child, path + "/" + name, type, changes);
+    }
+}
+
+void compare(const Node* current, const Node* previous, const std::string& path, std::vector<FileChange>& changes);
+
+// 两边的子节点都按名称有序，归并比较；path 为空时子节点名本身就是路径
+void compareChildren(const Node& current, const Node& previous, const std::string& path,
+                     std::vector<FileChange>& changes) {
+    auto childPath = [&path](const std::string& name) { return path.empty() ? name : path + "/" + name; };
+    auto a = current.children.begin();
+    auto b = previous.children.begin();
+    while (a != current.children.end() || b != previous.children.end()) {
+        if (b == previous.children.end() || (a != current.children.end() && a->first < b->first)) {
+            compare(&a->second, nullptr, childPath(a->first), changes);
+            ++a;
+        } else if (a == current.children.end() || b->first < a->first) {
+            compare(nullptr, &b->second, childPath(b->first), changes);
+            ++b;
+        } else {
+            compare(&a->second, &b->second, childPath(a->first), changes);
+            ++a;
+            ++b;
+        }
+    }
+}
+
+void compare(const Node* current, const Node* previous, const std::string& path, std::vector<FileChange>& changes) {
+    if (current && previous && current->directory == previous->directory) {
+        // 哈希相同的子树整棵跳过
+        if (current->hash == previous->hash) {
+            return;
+        }
+        if (current->directory) {
+            compareChildren(*current, *previous, path, changes);
+        } else {
+            changes.push_back({path, FileChangeType::Changed});
+        }
+        return;
+    }
+    if (previous) {
+        collect(*previous, path, FileChangeType::Deleted, changes);
+    }
+    if (current) {
+        collect(*current, path, FileChangeType::Created, changes);
+    }
+}
+
+} // namespace
+
+WorkspaceSnapshot WorkspaceSnapshot::scan(const std::vector<std::string>& roots,
+                                          const std::vector<std::string>& extensions,
+                                          const WorkspaceSnapshot* previous, size_t threadCount) {
+    WorkspaceSnapshot snapshot;
+    std::vector<HashJob> jobs;
+    for (const std::string& root : roots) {
+        std::error_code error;
+        std::string key = FileUtils::normalizePath(fs::absolute(root, error).lexically_normal().string());
+        Node& node = snapshot.root.children[key];
+        node.directory = true;
+        crawl(key, node, previous ? findChild(&previous->root, key) : nullptr, extensions, jobs);
+    }
+
+    // 读取和哈希并行进行，每个线程领取一段连续的文件
+    if (!jobs.empty()) {
+        WorkPool pool(threadCount);
+        constexpr size_t kBatch = 64;
+        std::mutex doneMutex;
+        std::condition_variable doneCondition;
+        size_t remaining = (jobs.size() + kBatch - 1) / kBatch;
+        for (size_t begin = 0; begin < jobs.size(); begin += kBatch) {
+            size_t end = std::min(jobs.size(), begin + kBatch);
+            pool.submit([&, begin, end]() {
+                for (size_t i = begin; i < end; ++i) {
+                    // 直接对映射的内容计算哈希，不复制
+                    FileView content;
+                    if (!content.open(jobs[i].path)) {
+                        jobs[i].failed = true;
+                        continue;
+                    }
+                    Node& file = jobs[i].parent->children.at(jobs[i].name);
+                    file.hash = XXHash64::hash(content.data(), content.size());
+                    file.size = content.size();
+                }
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (--remaining == 0) {
+                    doneCondition.notify_all();
+                }
+            });
+        }
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [&]() { return remaining == 0; });
+    }
+
+    // 遍历之后被删除或无法读取的文件不记入快照，否则会被当作空文件，
+    // 之后大小和修改时间碰巧一致时再也不会重新读取
+    size_t hashed = 0;
+    for (const HashJob& job : jobs) {
+        if (job.failed) {
+            job.parent->children.erase(job.name);
+        } else {
+            ++hashed;
+        }
+    }
+    snapshot.hashed = hashed;
+    finalize(snapshot.root, snapshot.files, snapshot.bytes);
+    return snapshot;
+}
+
+bool WorkspaceSnapshot::save(const std::string& path) const {
+    // 先写临时文件再改名，中途退出不会留下半个快照
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "无法写入工作区快照: " << temporary << std::endl;
+            return false;
+        }
+        json document = {{"format", kFormatVersion}, {"root", toJson(root)}};
+        file << document.dump();
+        if (!file.good()) {
+            std::cerr << "写入工作区快照失败: " << temporary << std::endl;
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "无法替换工作区快照: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WorkspaceSnapshot::load(const std::string& path, WorkspaceSnapshot& snapshot) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    json document = json::parse(file, nullptr, false);
+    if (document.is_discarded() || !document.is_object() || document.value("format", 0) != kFormatVersion) {
+        std::cerr << "忽略无法识别的工作区快照: " << path << std::endl;
+        return false;
+    }
+    try {
+        snapshot = WorkspaceSnapshot();
+        snapshot.root = fromJson(document.at("root"));
+        snapshot.root.directory = true;
+    } catch (const json::exception& e) {
+        std::cerr << "工作区快照格式错误: " << e.what() << std::endl;
+        return false;
+    }
+    tally(snapshot.root, snapshot.files, snapshot.bytes);
+    return true;
+}
+
+std::vector<FileChange> WorkspaceSnapshot::diff(const WorkspaceSnapshot& previous) const {
+    std::vector<FileChange> changes;
+    // 第一层的键就是扫描根目录的绝对路径
+    if (root.hash != previous.root.hash) {
+        compareChildren(root, previous.root, "", changes);
+    }
+    return changes;
+}
+
+std::string WorkspaceSnapshot::rootHash() const {
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(root.hash));
+    return text;
+}
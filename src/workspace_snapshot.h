@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "workspace_watcher.h"
+
+using json = nlohmann::json;
+
+// 工作区内容的 Merkle 树
+// 文件节点保存内容的 XXH64、大小和修改时间，目录节点的哈希由子节点的名称和哈希按名称顺序计算。
+// 两个快照比较时哈希相同的子树整棵跳过，只深入变化的目录
+class WorkspaceSnapshot {
+public:
+    struct Node {
+        Node() = default;
+        explicit Node(bool directory) : directory(directory) {}
+
+        bool directory = false;
+        uint64_t hash = 0;
+        uint64_t size = 0;       // 文件字节数
+        int64_t modified = 0;    // 文件修改时间（纳秒）
+        std::map<std::string, Node> children;
+    };
+
+    // 扫描 roots 下扩展名在 extensions 中的文件并行计算哈希；
+    // 提供 previous 时，大小和修改时间都没变的文件沿用旧哈希，不再读取
+    static WorkspaceSnapshot scan(const std::vector<std::string>& roots, const std::vector<std::string>& extensions,
+                                  const WorkspaceSnapshot* previous = nullptr, size_t threadCount = 0);
+
+    // 以 JSON 保存和读取，文件不存在或格式不符时 load 返回 false
+    bool save(const std::string& path) const;
+    static bool load(const std::string& path, WorkspaceSnapshot& snapshot);
+
+    // 相对 previous 变化的文件，路径为绝对路径
+    std::vector<FileChange> diff(const WorkspaceSnapshot& previous) const;
+
+    // 整个工作区的哈希，十六进制表示，用于和服务器确认双方看到的是同一份内容
+    std::string rootHash() const;
+
+    size_t fileCount() const { return files; }
+    uint64_t totalBytes() const { return bytes; }
+    size_t hashedFiles() const { return hashed; }
+
+private:
+    // 每个扫描根目录对应 root 下的一个子节点，键为规范化后的绝对路径
+    Node root{true};
+    size_t files = 0;
+    uint64_t bytes = 0;
+    size_t hashed = 0;  // 本次实际读取并计算哈希的文件数
+};
@@ -0,0 +1,236 @@
+#include "workspace_watcher.h"
+#include "file_utils.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                IN_DELETE_SELF | IN_ONLYDIR;
+
+// 同一路径先后两次变化合并后的结果，返回 false 表示两者抵消
+bool combine(FileChangeType previous, FileChangeType next, FileChangeType& result) {
+    if (previous == FileChangeType::Created) {
+        result = FileChangeType::Created;
+        return next != FileChangeType::Deleted;
+    }
+    if (next == FileChangeType::Deleted) {
+        result = FileChangeType::Deleted;
+        return true;
+    }
+    // 删除后重新出现，或修改后再被替换，对服务器来说都是内容变了
+    result = FileChangeType::Changed;
+    return true;
+}
+
+} // namespace
+
+WorkspaceWatcher::WorkspaceWatcher(EventLoop& loop)
+    : loop(loop), inotifyFd(-1), window(kCoalesceWindow), timerId(0) {}
+
+WorkspaceWatcher::~WorkspaceWatcher() {
+    stop();
+}
+
+bool WorkspaceWatcher::start(const std::vector<std::string>& roots, const std::vector<std::string>& extensions,
+                             BatchHandler handler, std::chrono::milliseconds window) {
+    stop();
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "inotify 初始化失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inotifyFd = fd;
+        this->extensions = extensions;
+        this->handler = std::move(handler);
+        this->window = window;
+        for (const std::string& root : roots) {
+            // 事件中的路径由目录拼接而来，相对路径会生成错误的 URI
+            std::error_code error;
+            addDirectory(FileUtils::normalizePath(fs::absolute(root, error).lexically_normal().string()), false);
+        }
+        if (directories.empty()) {
+            std::cerr << "没有可监视的目录" << std::endl;
+            ::close(inotifyFd);
+            inotifyFd = -1;
+            return false;
+        }
+    }
+    if (!loop.addFd(fd, EPOLLIN, [this](uint32_t) { onReadable(); })) {
+        std::cerr << "无法在事件循环上注册 inotify" << std::endl;
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void WorkspaceWatcher::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (inotifyFd < 0) {
+        return;
+    }
+    loop.removeFd(inotifyFd);
+    ::close(inotifyFd);
+    inotifyFd = -1;
+    directories.clear();
+    pending.clear();
+    order.clear();
+    if (timerId != 0) {
+        loop.cancelTimer(timerId);
+        timerId = 0;
+    }
+}
+
+bool WorkspaceWatcher::isWatching() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return inotifyFd >= 0;
+}
+
+void WorkspaceWatcher::addDirectory(const std::string& path, bool reportFiles) {
+    int wd = inotify_add_watch(inotifyFd, path.c_str(), kWatchMask);
+    if (wd < 0) {
+        std::cerr << "无法监视目录: " << path << " (" << strerror(errno) << ")" << std::endl;
+        return;
+    }
+    directories[wd] = path;
+
+    // 先加监视再遍历，之间新建的文件可能被报告两次，合并后不影响结果
+    std::error_code error;
+    fs::directory_iterator it(path, fs::directory_options::skip_permission_denied, error);
+    for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+        std::string name = it->path().filename().string();
+        fs::file_status status = it->symlink_status(error);
+        if (error || name.empty() || name[0] == '.') {
+            continue;
+        }
+        std::string child = it->path().string();
+        if (fs::is_directory(status)) {
+            addDirectory(child, reportFiles);
+        } else if (reportFiles && fs::is_regular_file(status) && FileUtils::hasExtension(child, extensions)) {
+            record(child, FileChangeType::Created);
+        }
+    }
+}
+
+void WorkspaceWatcher::removeDirectory(const std::string& path) {
+    // 移出的目录及其子目录不再属于工作区，旧路径上的监视不能继续上报
+    std::string prefix = path + "/";
+    for (auto it = directories.begin(); it != directories.end();) {
+        if (it->second == path || it->second.compare(0, prefix.size(), prefix) == 0) {
+            inotify_rm_watch(inotifyFd, it->first);
+            it = directories.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // 目录已不在原处，无法再列出其中的文件：窗口内已记录的子路径变化按删除合并，
+    // 再上报一次目录本身的删除，服务器据此移除目录下的所有文件
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (order[i].compare(0, prefix.size(), prefix) == 0 && pending.count(order[i]) != 0) {
+            record(order[i], FileChangeType::Deleted);
+        }
+    }
+    record(path, FileChangeType::Deleted);
+}
+
+void WorkspaceWatcher::record(const std::string& path, FileChangeType type) {
+    auto it = pending.find(path);
+    if (it == pending.end()) {
+        pending.emplace(path, type);
+        order.push_back(path);
+    } else if (!combine(it->second, type, it->second)) {
+        pending.erase(it);
+    }
+    if (timerId == 0) {
+        timerId = loop.addTimer(window, [this]() { onWindowEnd(); });
+    }
+}
+
+void WorkspaceWatcher::onReadable() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    std::lock_guard<std::mutex> lock(mutex);
+    while (inotifyFd >= 0) {
+        ssize_t length = ::read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length < 0 && errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        for (char* p = buffer; p < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                std::cerr << "inotify 事件队列溢出，部分文件变化已丢失" << std::endl;
+                continue;
+            }
+            auto dir = directories.find(event->wd);
+            if (dir == directories.end()) {
+                continue;
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+                directories.erase(dir);
+                continue;
+            }
+            if (event->len == 0 || event->name[0] == '.') {
+                continue;
+            }
+
+            std::string path = dir->second + "/" + event->name;
+            if (event->mask & IN_ISDIR) {
+                // 新目录（包括移入的目录）需要加监视，其中已有的文件作为新建上报
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    addDirectory(path, true);
+                } else if (event->mask & IN_MOVED_FROM) {
+                    removeDirectory(path);
+                }
+                continue;
+            }
+            if (!FileUtils::hasExtension(path, extensions)) {
+                continue;
+            }
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                record(path, FileChangeType::Deleted);
+            } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                record(path, FileChangeType::Created);
+            } else if (event->mask & IN_CLOSE_WRITE) {
+                record(path, FileChangeType::Changed);
+            }
+        }
+    }
+}
+
+void WorkspaceWatcher::onWindowEnd() {
+    std::vector<FileChange> changes;
+    BatchHandler callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        timerId = 0;
+        changes.reserve(pending.size());
+        for (const std::string& path : order) {
+            auto it = pending.find(path);
+            if (it != pending.end()) {
+                changes.push_back({path, it->second});
+                pending.erase(it);
+            }
+        }
+        order.clear();
+        callback = handler;
+    }
+    if (!changes.empty() && callback) {
+        callback(std::move(changes));
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "event_loop.h"
+
+// 文件变化类型，取值与 LSP FileChangeType 相同
+enum class FileChangeType {
+    Created = 1,
+    Changed = 2,
+    Deleted = 3
+};
+
+struct FileChange {
+    std::string path;
+    FileChangeType type;
+};
+
+// 基于 inotify 的目录监视
+// inotify fd 注册在事件循环上，窗口内同一路径的多次事件合并为一次：
+// 先写临时文件再改名的保存方式只留下目标文件的变化，创建后又删除的文件不会上报
+class WorkspaceWatcher {
+public:
+    using BatchHandler = std::function<void(std::vector<FileChange> changes)>;
+
+    // 合并窗口，从窗口内第一个事件开始计时
+    static constexpr std::chrono::milliseconds kCoalesceWindow{100};
+
+    explicit WorkspaceWatcher(EventLoop& loop);
+    ~WorkspaceWatcher();
+
+    WorkspaceWatcher(const WorkspaceWatcher&) = delete;
+    WorkspaceWatcher& operator=(const WorkspaceWatcher&) = delete;
+
+    // 递归监视 roots 下扩展名在 extensions 中的文件，每个窗口结束时在循环线程中调用 handler
+    // 已在监视时先停止；跳过隐藏目录
+    bool start(const std::vector<std::string>& roots, const std::vector<std::string>& extensions,
+               BatchHandler handler, std::chrono::milliseconds window = kCoalesceWindow);
+
+    // 停止监视并丢弃未上报的变化
+    void stop();
+
+    bool isWatching();
+
+private:
+    void onReadable();
+    void onWindowEnd();
+
+    // 调用方持有 mutex
+    void addDirectory(const std::string& path, bool reportFiles);
+    // 目录移出工作区：移除监视并上报目录删除
+    void removeDirectory(const std::string& path);
+    void record(const std::string& path, FileChangeType type);
+
+    EventLoop& loop;
+
+    std::mutex mutex;
+    int inotifyFd;
+    std::unordered_map<int, std::string> directories;  // watch descriptor -> 目录
+    std::vector<std::string> extensions;
+    BatchHandler handler;
+    std::chrono::milliseconds window;
+
+    // 窗口内合并后的变化，按首次出现的顺序上报
+    std::unordered_map<std::string, FileChangeType> pending;
+    std::vector<std::string> order;
+    uint64_t timerId;
+};
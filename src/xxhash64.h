@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// XXH64 非加密哈希，输出与参考实现一致，用于比较文件内容是否变化
+class XXHash64 {
+public:
+    static uint64_t hash(const void* data, size_t length, uint64_t seed = 0);
+};